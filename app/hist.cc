@@ -44,8 +44,6 @@
 #define IMG_DATA_OFFSET_POS 10
 #define BITS_PER_PIXEL_POS 28
 
-enum { pre_fault = 0 };
-
 int swap;			// to indicate if we need to swap byte order of header information
 short red_keys[256];
 short green_keys[256];
@@ -79,8 +77,7 @@ static void swap_bytes(char *bytes, int nbytes) {
 
 struct hist : public map_reduce {
     hist(char *d, size_t length, int nsplit) : s_(d, length, nsplit) {
-        if (pre_fault)
-            printf("ignore this sum %d\n", s_.prefault());
+        set_dense_keys(3 * 256);
     }
 
     bool split(split_t *ma, int ncore) {
@@ -93,8 +90,13 @@ struct hist : public map_reduce {
         prof_leaveapp();
         return r;
     }
-    void map_function(split_t *ma);
-    void reduce_function(void *key_in, void **vals_in, size_t vals_len);
+    /* keys are 1000 + i, 2000 + i and 3000 + i (see main) */
+    size_t dense_key(void *k, int) {
+        short key = *(short *)k;
+        return (key / 1000 - 1) * 256 + key % 1000;
+    }
+    void map_function(split_t *ma, emitter &e);
+    void reduce_function(void *key_in, void **vals_in, size_t vals_len, emitter &e);
     int combine_function(void *key_in, void **vals_in, size_t vals_len);
   private:
     defsplitter s_;
@@ -103,7 +105,7 @@ struct hist : public map_reduce {
 /* Map function that computes the histogram values for the portion
  * of the image assigned to the map task 
  */
-void hist::map_function(split_t * args) {
+void hist::map_function(split_t * args, emitter &e) {
     assert(args);
     short *key;
     unsigned char *val;
@@ -130,21 +132,21 @@ void hist::map_function(split_t * args) {
 	if (blue[i] > 0) {
 	    key = &(blue_keys[i]);
 	    prof_leaveapp();
-	    map_emit((void *)key, int2ptr(blue[i]), sizeof(short));
+	    e.map_emit((void *)key, int2ptr(blue[i]), sizeof(short));
 	    prof_enterapp();
 	}
 
 	if (green[i] > 0) {
 	    key = &(green_keys[i]);
 	    prof_leaveapp();
-	    map_emit((void *)key, int2ptr(green[i]), sizeof(short));
+	    e.map_emit((void *)key, int2ptr(green[i]), sizeof(short));
 	    prof_enterapp();
 	}
 
 	if (red[i] > 0) {
 	    key = &(red_keys[i]);
 	    prof_leaveapp();
-	    map_emit((void *) key, int2ptr(red[i]), sizeof(short));
+	    e.map_emit((void *) key, int2ptr(red[i]), sizeof(short));
 	    prof_enterapp();
 	}
     }
@@ -152,7 +154,7 @@ void hist::map_function(split_t * args) {
 }
 
 /* Reduce function that adds up the values for each location in the array */
-void hist::reduce_function(void *key_in, void **vals_in, size_t vals_len) {
+void hist::reduce_function(void *key_in, void **vals_in, size_t vals_len, emitter &e) {
     short *key = (short *) key_in;
     long *vals = (long *) vals_in;
     long sum = 0;
@@ -163,7 +165,7 @@ void hist::reduce_function(void *key_in, void **vals_in, size_t vals_len) {
     for (size_t i = 0; i < vals_len; i++)
 	sum += vals[i];
     prof_leaveapp();
-    reduce_emit(key, (void *) sum);
+    e.reduce_emit(key, (void *) sum);
 }
 
 /* Merge the intermediate date, return the length of data after merge */
@@ -188,6 +190,7 @@ static void usage(char *prog) {
     printf("  -m #map tasks : # of map tasks (pre-split input before MR)\n");
     printf("  -r #reduce tasks : # of reduce tasks\n");
     printf("  -q : quiet output (for batch test)\n");
+    printf("  -S strategy : execution strategy, e.g. mode=metis,map-ds=btree,sort=psrs\n");
     printf("  -d : debug output\n");
     exit(EXIT_FAILURE);
 }
@@ -197,7 +200,8 @@ int main(int argc, char *argv[]) {
     if (argc < 2)
 	usage(argv[0]);
     int c;
-    while ((c = getopt(argc - 1, argv + 1, "p:m:r:q")) != -1) {
+    const char *spec = NULL;
+    while ((c = getopt(argc - 1, argv + 1, "p:m:r:qS:")) != -1) {
 	switch (c) {
 	case 'p':
 	    nprocs = atoi(optarg);
@@ -208,6 +212,9 @@ int main(int argc, char *argv[]) {
 	case 'r':
 	    reduce_tasks = atoi(optarg);
 	    break;
+	case 'S':
+	    spec = optarg;
+	    break;
 	case 'q':
 	    quiet = 1;
 	    break;
@@ -252,6 +259,10 @@ int main(int argc, char *argv[]) {
     hist app(&mf[*data_pos], imgdata_bytes, map_tasks);
     app.set_reduce_task(reduce_tasks);
     app.set_ncore(nprocs);
+    if (spec && !app.set_strategy(spec)) {
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
     app.sched_run();
     app.print_stats();
 
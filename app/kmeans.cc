@@ -82,13 +82,16 @@ struct kmeans_map_data_t {
 };
 
 struct kmeans : public map_reduce {
-    void map_function(split_t *ma);
-    void reduce_function(void *k, void **v, size_t length);
+    void map_function(split_t *ma, emitter &e);
+    void reduce_function(void *k, void **v, size_t length, emitter &e);
     int combine_function(void *k, void **v, size_t length);
     void *inplace_modify(void *oldv, void *newv);
     unsigned partition(void *k, int) {
         return ptr2int<unsigned>(k);
     } 
+    size_t dense_key(void *k, int) {
+        return *(int *)k;
+    }
     bool split(split_t *out, int ncores);
     bool has_value_modifier() {
         return with_value_modifier;
@@ -101,7 +104,8 @@ struct kmeans : public map_reduce {
     }
     kmeans_data_t kd_;
   private:
-    void find_clusters(int **points, keyval_t * means, int *clusters, int size);
+    void find_clusters(int **points, keyval_t * means, int *clusters, int size,
+                       emitter &e);
 };
 
 /** dump_means()
@@ -134,6 +138,7 @@ static void usage(char *fn) {
     printf("  -r #reduce tasks: # of reduce tasks\n");
     printf("  -l ntops : # of top val. pairs to display\n");
     printf("  -q : quiet output (for batch test)\n");
+    printf("  -S strategy : execution strategy, e.g. mode=metis,map-ds=btree,sort=psrs\n");
 }
 
 /** parse_args()
@@ -178,7 +183,8 @@ void add_to_sum(int *sum, int *point) {
 }
 
 /* Find the cluster that is most suitable for a given set of points */
-void kmeans::find_clusters(int **points, keyval_t *means, int *clusters, int size) {
+void kmeans::find_clusters(int **points, keyval_t *means, int *clusters, int size,
+                           emitter &e) {
     unsigned int min_dist, cur_dist;
     int min_idx;
     for (int i = 0; i < size; i++) {
@@ -198,7 +204,7 @@ void kmeans::find_clusters(int **points, keyval_t *means, int *clusters, int siz
 	}
 	//printf("Emitting [%d,%d]\n", *((int *)means[min_idx].key), *(points[i]));
 	prof_leaveapp();
-	map_emit(means[min_idx].key_, (void *)points[i], sizeof(means[min_idx].key_));
+	e.map_emit(means[min_idx].key_, (void *)points[i], sizeof(means[min_idx].key_));
 	prof_enterapp();
     }
 }
@@ -226,12 +232,12 @@ bool kmeans::split(split_t *out, int ncores) {
 }
 
 /** Finds the cluster that is most suitable for a given set of points */
-void kmeans::map_function(split_t * split) {
+void kmeans::map_function(split_t * split, emitter &e) {
     assert(split->length == 1);
     prof_enterapp();
     kmeans_map_data_t *map_data = (kmeans_map_data_t *)split->data;
     find_clusters(map_data->points, map_data->means, map_data->clusters,
-		  map_data->length);
+		  map_data->length, e);
     free(map_data);
     prof_leaveapp();
 }
@@ -260,7 +266,7 @@ int kmeans::combine_function(void *key_in, void **vals_in, size_t vals_len) {
 }
 
 /** Updates the sum calculation for the various points */
-void kmeans::reduce_function(void *key_in, void **vals_in, size_t vals_len) {
+void kmeans::reduce_function(void *key_in, void **vals_in, size_t vals_len, emitter &e) {
     assert(key_in && vals_in);
     prof_enterapp();
     int *sum = (int *) calloc(dim, sizeof(int));
@@ -287,7 +293,7 @@ void kmeans::reduce_function(void *key_in, void **vals_in, size_t vals_len) {
 
     free(sum);
     prof_leaveapp();
-    reduce_emit(key_in, (void *)mean);
+    e.reduce_emit(key_in, (void *)mean);
 }
 
 static void init_kmeans(kmeans_data_t &kd, int nsplit) {
@@ -321,9 +327,10 @@ int main(int argc, char **argv) {
     int nprocs = 0, ndisp = 0, map_tasks = 0, reduce_tasks = 0;
     int quiet = 0;
     int c;
+    const char *spec = NULL;
 
     parse_args(argc, argv);
-    while ((c = getopt(argc - 4, argv + 4, "p:m:l:r:q")) != -1) {
+    while ((c = getopt(argc - 4, argv + 4, "p:m:l:r:qS:")) != -1) {
 	switch (c) {
 	case 'p':
 	    assert((nprocs = atoi(optarg)) >= 0);
@@ -337,6 +344,9 @@ int main(int argc, char **argv) {
 	case 'l':
 	    assert((ndisp = atoi(optarg)) >= 0);
 	    break;
+	case 'S':
+	    spec = optarg;
+	    break;
 	case 'q':
 	    quiet = 1;
 	    break;
@@ -348,8 +358,15 @@ int main(int argc, char **argv) {
     mapreduce_appbase::initialize();
     kmeans app;
     init_kmeans(app.kd_, map_tasks);
+    app.set_dense_keys(num_means);
+    // the results are indexed by mean
+    app.set_unordered_output(true);
     app.set_reduce_task(reduce_tasks);
     app.set_ncore(nprocs);
+    if (spec && !app.set_strategy(spec)) {
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
     modified = true;
     pthread_mutex_init(&lock, NULL);
     while (modified) {
@@ -362,10 +379,13 @@ int main(int argc, char **argv) {
 	    stats = NULL;
 	}
         app.sched_run();
-	for (size_t i = 0; i < app.results_.size(); ++i) {
-	    int mean_idx = *((int *)app.results_[i].key_);
-	    free(app.kd_.means[mean_idx].val);
-	    app.kd_.means[mean_idx] = app.results_[i];
+	for (size_t s = 0; s < app.result_segments_.size(); ++s) {
+	    xarray<keyval_t> &r = app.result_segments_[s];
+	    for (size_t i = 0; i < r.size(); ++i) {
+		int mean_idx = *((int *)r[i].key_);
+		free(app.kd_.means[mean_idx].val);
+		app.kd_.means[mean_idx] = r[i];
+	    }
 	}
         app.free_results();
     }
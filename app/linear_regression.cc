@@ -41,8 +41,6 @@
 #include "defsplitter.hh"
 #include "bench.hh"
 
-enum { pre_fault = 0 };
-
 struct POINT_T {
     char x;
     char y;
@@ -59,8 +57,9 @@ enum {
 struct lr : public map_reduce {
     lr(const char *f, int nsplit) : s_(f, nsplit) {
         s_.trim(round_down(s_.size(), sizeof(POINT_T)));
-        if (pre_fault)
-            printf("ignore this %d\n", s_.prefault());
+        set_dense_keys(KEY_SXY + 1);
+        // main looks the results up by key
+        set_unordered_output(true);
     }
     int key_compare(const void *v1, const void *v2) {
         prof_enterkcmp();
@@ -77,14 +76,17 @@ struct lr : public map_reduce {
         assert(length == sizeof(void *));
         return unsigned(intptr_t(k));
     }
-    void map_function(split_t *);
-    void reduce_function(void *k, void **v, size_t length);
+    size_t dense_key(void *k, int) {
+        return size_t(k);
+    }
+    void map_function(split_t *, emitter &e);
+    void reduce_function(void *k, void **v, size_t length, emitter &e);
     int combine_function(void *k, void **v, size_t length);
     defsplitter s_;
 };
 
 /** Sorts based on the val output of wordcount */
-void lr::map_function(split_t *args) {
+void lr::map_function(split_t *args, emitter &e) {
     assert(args);
     POINT_T *data = (POINT_T *) args->data;
     assert(data);
@@ -101,14 +103,14 @@ void lr::map_function(split_t *args) {
 	SXY += data[i].x * data[i].y;
     }
     prof_leaveapp();
-    map_emit((void *) KEY_SX, (void *) SX, sizeof(void *));
-    map_emit((void *) KEY_SXX, (void *) SXX, sizeof(void *));
-    map_emit((void *) KEY_SY, (void *) SY, sizeof(void *));
-    map_emit((void *) KEY_SYY, (void *) SYY, sizeof(void *));
-    map_emit((void *) KEY_SXY, (void *) SXY, sizeof(void *));
+    e.map_emit((void *) KEY_SX, (void *) SX, sizeof(void *));
+    e.map_emit((void *) KEY_SXX, (void *) SXX, sizeof(void *));
+    e.map_emit((void *) KEY_SY, (void *) SY, sizeof(void *));
+    e.map_emit((void *) KEY_SYY, (void *) SYY, sizeof(void *));
+    e.map_emit((void *) KEY_SXY, (void *) SXY, sizeof(void *));
 }
 
-void lr::reduce_function(void *key_in, void **vals_in, size_t vals_len) {
+void lr::reduce_function(void *key_in, void **vals_in, size_t vals_len, emitter &e) {
     prof_enterapp();
     long long *vals = (long long *) vals_in;
     long long sum = 0;
@@ -116,7 +118,7 @@ void lr::reduce_function(void *key_in, void **vals_in, size_t vals_len) {
     for (size_t i = 0; i < vals_len; i++)
 	sum += (uint64_t) vals[i];
     prof_enterapp();
-    reduce_emit(key_in, (void *) sum);
+    e.reduce_emit(key_in, (void *) sum);
 }
 
 int lr::combine_function(void *, void **vals_in, size_t vals_len) {
@@ -139,17 +141,19 @@ static void usage(char *prog) {
     printf("  -r #reduce tasks : # of reduce tasks\n");
     printf("  -l ntops : # of top val. pairs to display\n");
     printf("  -q : quiet output (for batch test)\n");
+    printf("  -S strategy : execution strategy, e.g. mode=metis,map-ds=btree,sort=psrs\n");
     printf("  -d : debug output\n");
 }
 
 int main(int argc, char *argv[]) {
     int nprocs = 0, map_tasks = 0, quiet = 0;
     int c;
+    const char *spec = NULL;
     if (argc < 2) {
 	usage(argv[0]);
 	exit(EXIT_FAILURE);
     }
-    while ((c = getopt(argc - 1, argv + 1, "p:m:q")) != -1) {
+    while ((c = getopt(argc - 1, argv + 1, "p:m:qS:")) != -1) {
 	switch (c) {
 	case 'p':
 	    nprocs = atoi(optarg);
@@ -157,6 +161,9 @@ int main(int argc, char *argv[]) {
 	case 'm':
 	    map_tasks = atoi(optarg);
 	    break;
+	case 'S':
+	    spec = optarg;
+	    break;
 	case 'q':
 	    quiet = 1;
 	    break;
@@ -169,6 +176,10 @@ int main(int argc, char *argv[]) {
     mapreduce_appbase::initialize();
     lr app(argv[1], map_tasks);
     app.set_ncore(nprocs);
+    if (spec && !app.set_strategy(spec)) {
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
     cond_printf(!quiet, "Linear regression: running...\n");
     app.sched_run();
     app.print_stats();
@@ -177,28 +188,30 @@ int main(int argc, char *argv[]) {
     double a, b, xbar, ybar, r2;
     long long SX_ll = 0, SY_ll = 0, SXX_ll = 0, SYY_ll = 0, SXY_ll = 0;
     // ADD UP RESULTS
-    for (size_t i = 0; i < app.results_.size(); ++i) {
-	keyval_t *curr = &app.results_[i];
-	switch ((long int) curr->key_) {
-	case KEY_SX:
-	    SX_ll = (long long) curr->val;
-	    break;
-	case KEY_SY:
-	    SY_ll = (long long) curr->val;
-	    break;
-	case KEY_SXX:
-	    SXX_ll = (long long) curr->val;
-	    break;
-	case KEY_SYY:
-	    SYY_ll = (long long) curr->val;
-	    break;
-	case KEY_SXY:
-	    SXY_ll = (long long) curr->val;
-	    break;
-	default:
-	    // INVALID KEY
-	    assert(0);
-	    break;
+    for (size_t s = 0; s < app.result_segments_.size(); ++s) {
+	for (size_t i = 0; i < app.result_segments_[s].size(); ++i) {
+	    keyval_t *curr = &app.result_segments_[s][i];
+	    switch ((long int) curr->key_) {
+	    case KEY_SX:
+		SX_ll = (long long) curr->val;
+		break;
+	    case KEY_SY:
+		SY_ll = (long long) curr->val;
+		break;
+	    case KEY_SXX:
+		SXX_ll = (long long) curr->val;
+		break;
+	    case KEY_SYY:
+		SYY_ll = (long long) curr->val;
+		break;
+	    case KEY_SXY:
+		SXY_ll = (long long) curr->val;
+		break;
+	    default:
+		// INVALID KEY
+		assert(0);
+		break;
+	    }
 	}
     }
 
@@ -54,7 +54,8 @@ int main(int argc, char *argv[]) {
     }
 
     int c;
-    while ((c = getopt(argc, argv, "p:m:ql:")) != -1) {
+    const char *spec = NULL;
+    while ((c = getopt(argc, argv, "p:m:ql:S:")) != -1) {
 	switch (c) {
 	case 'p':
 	    assert((nprocs = atoi(optarg)) >= 0);
@@ -62,6 +63,9 @@ int main(int argc, char *argv[]) {
 	case 'm':
 	    map_tasks = atoi(optarg);
 	    break;
+	case 'S':
+	    spec = optarg;
+	    break;
 	case 'q':
 	    quiet = 1;
 	    break;
@@ -94,6 +98,10 @@ int main(int argc, char *argv[]) {
     app.d_.output = ((int *) fdata_out);
 
     app.set_ncore(nprocs);
+    if (spec && !app.set_strategy(spec)) {
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
     app.sched_run();
     app.print_stats();
     if (!quiet) {
@@ -53,6 +53,8 @@
 //#define HADOOP
 
 static int alphanumeric;
+static int zero_copy;
+static int unordered;
 
 struct minmaponly : public map_only {
     minmaponly(const char *f, int nsplit) : s_(f, nsplit) {}
@@ -62,14 +64,30 @@ struct minmaponly : public map_only {
     int key_compare(const void *s1, const void *s2) {
         return strcmp((const char *) s1, (const char *) s2);
     }
-    void map_function(split_t *ma) {
+    void map_function(split_t *ma, emitter &e) {
         char k[1024];
         size_t klen;
         split_word sw(ma);
+        if (zero_copy) {
+            while (char *w = sw.next(klen))
+                e.map_emit(w, (void *)1, klen);
+            return;
+        }
         while (sw.fill(k, sizeof(k), klen))
-            map_emit(k, (void *)1, klen);
+            e.map_emit(k, (void *)1, klen);
+    }
+    bool buffered_map_emit() {
+        return true;
+    }
+    bool stable_map_keys() {
+        return zero_copy;
+    }
+    bool bulk_free_keys() {
+        return zero_copy;
     }
     void *key_copy(void *src, size_t s) {
+        if (zero_copy)
+            return src;
         char *key = safe_malloc<char>(s + 1);
         memcpy(key, src, s);
         key[s] = 0;
@@ -79,28 +97,33 @@ struct minmaponly : public map_only {
     defsplitter s_;
 };
 
-static void print_top(xarray<keyval_t> *wc_vals, size_t ndisp) {
-    size_t occurs = 0;
-    for (uint32_t i = 0; i < wc_vals->size(); i++)
-	occurs += size_t(wc_vals->at(i)->val);
+static void print_top(xarray<keyval_t> **a, size_t na, size_t ndisp) {
+    size_t occurs = 0, nkey = 0;
+    for (size_t s = 0; s < na; s++) {
+        nkey += a[s]->size();
+        for (uint32_t i = 0; i < a[s]->size(); i++)
+            occurs += size_t(a[s]->at(i)->val);
+    }
     printf("\nwordcount: results (TOP %zd from %zu keys, %zd words):\n",
-           ndisp, wc_vals->size(), occurs);
+           ndisp, nkey, occurs);
 #ifdef HADOOP
-    ndisp = wc_vals->size();
+    ndisp = nkey;
 #else
-    ndisp = std::min(ndisp, wc_vals->size());
+    ndisp = std::min(ndisp, nkey);
 #endif
-    for (size_t i = 0; i < ndisp; i++) {
-	keyval_t *w = wc_vals->at(i);
-	printf("%15s - %d\n", (char *)w->key_, ptr2int<unsigned>(w->val));
-    }
+    for (size_t s = 0; s < na && ndisp; s++)
+        for (size_t i = 0; i < a[s]->size() && ndisp; i++, ndisp--) {
+            keyval_t *w = a[s]->at(i);
+            printf("%15s - %d\n", (char *)w->key_, ptr2int<unsigned>(w->val));
+        }
 }
 
-static void output_all(xarray<keyval_t> *wc_vals, FILE *fout) {
-    for (uint32_t i = 0; i < wc_vals->size(); i++) {
-	keyval_t *w = wc_vals->at(i);
-	fprintf(fout, "%18s - %lu\n", (char *)w->key_,  (uintptr_t)w->val);
-    }
+static void output_all(xarray<keyval_t> **a, size_t na, FILE *fout) {
+    for (size_t s = 0; s < na; s++)
+        for (uint32_t i = 0; i < a[s]->size(); i++) {
+            keyval_t *w = a[s]->at(i);
+            fprintf(fout, "%18s - %lu\n", (char *)w->key_,  (uintptr_t)w->val);
+        }
 }
 
 static void usage(char *prog) {
@@ -110,8 +133,11 @@ static void usage(char *prog) {
     printf("  -m #map tasks : # of map tasks (pre-split input before MR)\n");
     printf("  -l ntops : # of top val. pairs to display\n");
     printf("  -q : quiet output (for batch test)\n");
+    printf("  -S strategy : execution strategy, e.g. mode=metis,map-ds=btree,sort=psrs\n");
     printf("  -a : alphanumeric word count\n");
     printf("  -o filename : save output to a file\n");
+    printf("  -z : use the words of the input as keys without copying them\n");
+    printf("  -u : leave the output unsorted, in the order of the map output\n");
     exit(EXIT_FAILURE);
 }
 
@@ -119,12 +145,13 @@ int main(int argc, char *argv[]) {
     int nprocs = 0, map_tasks = 0, ndisp = 5;
     int quiet = 0;
     int c;
+    const char *spec = NULL;
     if (argc < 2)
 	usage(argv[0]);
     char *fn = argv[1];
     FILE *fout = NULL;
 
-    while ((c = getopt(argc - 1, argv + 1, "p:s:l:m:qao:")) != -1) {
+    while ((c = getopt(argc - 1, argv + 1, "p:s:l:m:qao:S:zu")) != -1) {
 	switch (c) {
 	case 'p':
 	    nprocs = atoi(optarg);
@@ -135,12 +162,21 @@ int main(int argc, char *argv[]) {
 	case 'm':
 	    map_tasks = atoi(optarg);
 	    break;
+	case 'S':
+	    spec = optarg;
+	    break;
 	case 'q':
 	    quiet = 1;
 	    break;
 	case 'a':
 	    alphanumeric = 1;
 	    break;
+	case 'z':
+	    zero_copy = 1;
+	    break;
+	case 'u':
+	    unordered = 1;
+	    break;
 	case 'o':
 	    fout = fopen(optarg, "w+");
 	    if (!fout) {
@@ -159,13 +195,24 @@ int main(int argc, char *argv[]) {
     /* get input file */
     minmaponly app(fn, map_tasks);
     app.set_ncore(nprocs);
+    if (spec && !app.set_strategy(spec)) {
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    app.set_unordered_output(unordered);
     app.sched_run();
     app.print_stats();
+    xarray<xarray<keyval_t> *> out;
+    if (unordered)
+        for (size_t s = 0; s < app.result_segments_.size(); ++s)
+            out.push_back(&app.result_segments_[s]);
+    else
+        out.push_back(&app.results_);
     /* get the number of results to display */
     if (!quiet)
-	print_top(&app.results_, ndisp);
+	print_top(out.array(), out.size(), ndisp);
     if (fout) {
-	output_all(&app.results_, fout);
+	output_all(out.array(), out.size(), fout);
 	fclose(fout);
     }
     app.free_results();
@@ -62,10 +62,9 @@ bool mm::split_nonblock(split_t *out, int ncores) {
 	nsplit_ = ncores * def_nsplits_per_core;
     uint64_t split_size = d_.matrix_len / nsplit_;
     assert(d_.row_num <= d_.matrix_len);
-    printf("Required units is %ld\n", split_size);
+    dprintf("Required units is %ld\n", split_size);
     /* Reached the end of the matrix */
     if (d_.row_num >= d_.matrix_len) {
-	fflush(stdout);
 	free(data_out);
 	return false;
     }
@@ -96,13 +95,11 @@ void mm::map_function_nonblock(split_t *args) {
 	    }
 	    x_loc = (data->row_num + row_count);
 	    data->output[x_loc * data->matrix_len + i] = value;
-	    fflush(stdout);
 	}
 	dprintf("%d Loop\n", data->row_num);
 	row_count++;
     }
-    printf("Finished Map task %d\n", data->row_num);
-    fflush(stdout);
+    dprintf("Finished Map task %d\n", data->row_num);
     free(data);
     prof_leaveapp();
 }
@@ -160,6 +157,7 @@ inline void usage(char *fn) {
     printf("  -p nprocs : # of processors to use\n");
     printf("  -m #map tasks : # of map tasks (pre-split input before MR)\n");
     printf("  -q : quiet output (for batch test)\n");
+    printf("  -S strategy : execution strategy, e.g. mode=metis,map-ds=btree,sort=psrs\n");
     printf("  -l : matrix dimentions. (assume squaure)\n");
 }
 
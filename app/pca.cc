@@ -94,10 +94,10 @@ struct pca_mean : map_reduce {
         return r;
     }
     bool split(split_t *out, int ncores);
-    void map_function(split_t *out);
-    void reduce_function(void *key, void **vals, size_t length) {
+    void map_function(split_t *out, emitter &e);
+    void reduce_function(void *key, void **vals, size_t length, emitter &e) {
         assert(length == 1);
-        reduce_emit(key, vals[0]);
+        e.reduce_emit(key, vals[0]);
     }
 };
 
@@ -158,7 +158,7 @@ bool pca_mean::split(split_t * out, int ncores) {
 }
 
 /** Map task to compute the mean */
-void pca_mean::map_function(split_t *args) {
+void pca_mean::map_function(split_t *args, emitter &e) {
     prof_enterapp();
     pca_map_data_t *data = (pca_map_data_t *) args->data;
     int **matrix = data->matrix;
@@ -172,7 +172,7 @@ void pca_mean::map_function(split_t *args) {
 	int *curr_row = safe_malloc<int>();
 	*curr_row = data->start_row;
 	prof_leaveapp();
-	map_emit((void *) curr_row, (void *) mean, sizeof(int *));
+	e.map_emit((void *) curr_row, (void *) mean, sizeof(int));
 	prof_enterapp();
 	++data->start_row;
     }
@@ -199,10 +199,10 @@ struct pca_cov : public map_reduce {
         return r;
     }
     bool split(split_t *out, int ncore);
-    void map_function(split_t *ma);
-    void reduce_function(void *key, void **vals, size_t length) {
+    void map_function(split_t *ma, emitter &e);
+    void reduce_function(void *key, void **vals, size_t length, emitter &e) {
         assert(length == 1);
-        reduce_emit(key, vals[0]);
+        e.reduce_emit(key, vals[0]);
     }
 };
 
@@ -250,7 +250,7 @@ bool pca_cov::split(split_t *out, int ncores) {
     return true;
 }
 
-void pca_cov::map_function(split_t * args) {
+void pca_cov::map_function(split_t * args, emitter &e) {
     assert(args);
     assert(args->length == 1);
     prof_enterapp();
@@ -285,7 +285,7 @@ void pca_cov::map_function(split_t * args) {
 	cov_loc->start_row = cov_data->cov_locs[i].start_row;
 	cov_loc->cov_row = cov_data->cov_locs[i].cov_row;
 	prof_leaveapp();
-	map_emit((void *) cov_loc, (void *) covariance, sizeof(pca_cov_loc_t));
+	e.map_emit((void *) cov_loc, (void *) covariance, sizeof(pca_cov_loc_t));
 	prof_enterapp();
     }
 
@@ -302,6 +302,7 @@ static void usage(char *fn) {
     printf("  -m #map tasks : # of map tasks (pre-split input before MR)\n");
     printf("  -r #reduce tasks : # of reduce tasks\n");
     printf("  -q : quiet output (for batch test)\n");
+    printf("  -S strategy : execution strategy, e.g. mode=metis,map-ds=btree,sort=psrs\n");
     printf("  -R row : # of matrix\n");
     printf("  -C col : # of matrix\n");
     printf("  -M max : # of max number\n");
@@ -318,7 +319,8 @@ int main(int argc, char **argv) {
 	exit(EXIT_FAILURE);
     }
 
-    while ((c = getopt(argc, argv, "p:m:R:M:C:R:r:q")) != -1) {
+    const char *spec = NULL;
+    while ((c = getopt(argc, argv, "p:m:R:M:C:R:r:qS:")) != -1) {
 	switch (c) {
 	case 'r':
 	    assert((nreduce_tasks = atoi(optarg)) >= 0);
@@ -329,6 +331,9 @@ int main(int argc, char **argv) {
 	case 'm':
 	    map_tasks = atoi(optarg);
 	    break;
+	case 'S':
+	    spec = optarg;
+	    break;
 	case 'q':
 	    quiet = 1;
 	    break;
@@ -366,6 +371,10 @@ int main(int argc, char **argv) {
     mapreduce_appbase::initialize();
     pca_mean m;
     m.set_ncore(nprocs);
+    if (spec && !m.set_strategy(spec)) {
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
 #ifndef MAPONLY
     m.set_reduce_task(nreduce_tasks);
 #endif
@@ -379,6 +388,10 @@ int main(int argc, char **argv) {
 
     pca_cov cov;
     cov.set_ncore(nprocs);
+    if (spec && !cov.set_strategy(spec)) {
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
 #ifndef MAPONLY
     cov.set_reduce_task(nreduce_tasks);
 #endif
@@ -64,22 +64,31 @@ static char *key4_final;
 static str_data_t str_data;
 
 struct sm : public map_reduce {
-    sm(char* f, int nsplit) : s_(f, nsplit) {}
+    sm(char* f, int nsplit) : s_(f, nsplit) {
+        set_dense_keys(4);
+    }
     int key_compare(const void *v1, const void *v2) {
         prof_enterkcmp();
         int r = strcmp((char *) v1, (char *) v2);
         prof_leavekcmp();
         return r;
     }
-    void map_function(split_t *ma);
+    void map_function(split_t *ma, emitter &e);
     bool split(split_t* ma, int ncore) {
         prof_enterapp();
         bool r = s_.split(ma, ncore, " \t\n\r\0");
         prof_leaveapp();
         return r;
     }
-    void reduce_function(void *key_in, void **vals_in, size_t vals_len);
+    void reduce_function(void *key_in, void **vals_in, size_t vals_len, emitter &e);
     int combine_function(void *key_in, void **vals_in, size_t vals_len);
+    size_t dense_key(void *k, int) {
+        const char *keys[] = {key1, key2, key3, key4};
+        for (size_t i = 0; i < 4; ++i)
+            if (!strcmp((const char *)k, keys[i]))
+                return i;
+        assert(0);
+    }
   private:
     defsplitter s_;
 };
@@ -93,7 +102,7 @@ static void compute_hashes(const char *word, char *final_word) {
 }
 
 /* Map Function that checks the hash of each word to the given hashes */
-void sm::map_function(split_t *ma) {
+void sm::map_function(split_t *ma, emitter &e) {
     prof_enterapp();
     split_word sw(ma);
     char cur_word[MAX_REC_LEN];
@@ -120,10 +129,10 @@ void sm::map_function(split_t *ma) {
 	}
     }
     prof_leaveapp();
-    map_emit((void *)key1, (void *) (size_t) cnt1, strlen(key1));
-    map_emit((void *)key2, (void *) (size_t) cnt2, strlen(key2));
-    map_emit((void *)key3, (void *) (size_t) cnt3, strlen(key3));
-    map_emit((void *)key4, (void *) (size_t) cnt4, strlen(key4));
+    e.map_emit((void *)key1, (void *) (size_t) cnt1, strlen(key1));
+    e.map_emit((void *)key2, (void *) (size_t) cnt2, strlen(key2));
+    e.map_emit((void *)key3, (void *) (size_t) cnt3, strlen(key3));
+    e.map_emit((void *)key4, (void *) (size_t) cnt4, strlen(key4));
 }
 
 int sm::combine_function(void *key_in, void **vals_in, size_t vals_len) {
@@ -139,7 +148,7 @@ int sm::combine_function(void *key_in, void **vals_in, size_t vals_len) {
     return 1;
 }
 
-void sm::reduce_function(void *key_in, void **vals_in, size_t vals_len) {
+void sm::reduce_function(void *key_in, void **vals_in, size_t vals_len, emitter &e) {
     char *key = (char *) key_in;
     long *vals = (long *) vals_in;
     long sum = 0;
@@ -148,7 +157,7 @@ void sm::reduce_function(void *key_in, void **vals_in, size_t vals_len) {
     for (size_t i = 0; i < vals_len; i++)
 	sum += vals[i];
     prof_leaveapp();
-    reduce_emit(key, (void *) sum);
+    e.reduce_emit(key, (void *) sum);
 }
 
 static void usage(char *prog) {
@@ -160,6 +169,7 @@ static void usage(char *prog) {
     printf("  -s split size(KB) : # of kilo-bytes for each split\n");
     printf("  -l ntops : # of top val. pairs to display\n");
     printf("  -q : quiet output (for batch test)\n");
+    printf("  -S strategy : execution strategy, e.g. mode=metis,map-ds=btree,sort=psrs\n");
     printf("  -d : debug output\n");
     exit(EXIT_FAILURE);
 }
@@ -173,7 +183,8 @@ int main(int argc, char *argv[]) {
 	exit(EXIT_FAILURE);
     }
     int c;
-    while ((c = getopt(argc - 1, argv + 1, "p:m:r:q")) != -1) {
+    const char *spec = NULL;
+    while ((c = getopt(argc - 1, argv + 1, "p:m:r:qS:")) != -1) {
 	switch (c) {
 	case 'p':
 	    nprocs = atoi(optarg);
@@ -184,6 +195,9 @@ int main(int argc, char *argv[]) {
 	case 'r':
 	    reduce_tasks = atoi(optarg);
 	    break;
+	case 'S':
+	    spec = optarg;
+	    break;
 	case 'q':
 	    quiet = 1;
 	    break;
@@ -221,6 +235,10 @@ int main(int argc, char *argv[]) {
     mapreduce_appbase::initialize();
     sm app(argv[1], map_tasks);
     app.set_ncore(nprocs);
+    if (spec && !app.set_strategy(spec)) {
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
     app.set_reduce_task(reduce_tasks);
     app.sched_run();
     app.print_stats();
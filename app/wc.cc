@@ -54,6 +54,7 @@
 enum { with_value_modifier = 1 };
 
 static int alphanumeric;
+static int zero_copy;
 
 struct wc : public map_reduce {
     wc(const char *f, int nsplit) : s_(f, nsplit) {}
@@ -63,20 +64,25 @@ struct wc : public map_reduce {
     int key_compare(const void *s1, const void *s2) {
         return strcmp((const char *) s1, (const char *) s2);
     }
-    void map_function(split_t *ma) {
+    void map_function(split_t *ma, emitter &e) {
         char k[1024];
         size_t klen;
         split_word sw(ma);
+        if (zero_copy) {
+            while (char *w = sw.next(klen))
+                e.map_emit(w, (void *)1, klen);
+            return;
+        }
         while (sw.fill(k, sizeof(k), klen))
-            map_emit(k, (void *)1, klen);
+            e.map_emit(k, (void *)1, klen);
     }
     /* Add up the partial sums for each word */
-    void reduce_function(void *key_in, void **vals_in, size_t vals_len) {
+    void reduce_function(void *key_in, void **vals_in, size_t vals_len, emitter &e) {
         long sum = 0;
         long *vals = (long *) vals_in;
         for (uint32_t i = 0; i < vals_len; i++)
 	    sum += vals[i];
-        reduce_emit(key_in, (void *) sum);
+        e.reduce_emit(key_in, (void *) sum);
     }
 
     /* write back the sums */
@@ -94,7 +100,18 @@ struct wc : public map_reduce {
         return (void *) (v + nv);
     }
 
+    bool buffered_map_emit() {
+        return true;
+    }
+    bool stable_map_keys() {
+        return zero_copy;
+    }
+    bool bulk_free_keys() {
+        return zero_copy;
+    }
     void *key_copy(void *src, size_t s) {
+        if (zero_copy)
+            return src;
         char *key = safe_malloc<char>(s + 1);
         memcpy(key, src, s);
         key[s] = 0;
@@ -153,8 +170,10 @@ static void usage(char *prog) {
     printf("  -r #reduce tasks : # of reduce tasks\n");
     printf("  -l ntops : # of top val. pairs to display\n");
     printf("  -q : quiet output (for batch test)\n");
+    printf("  -S strategy : execution strategy, e.g. mode=metis,map-ds=btree,sort=psrs\n");
     printf("  -a : alphanumeric word count\n");
     printf("  -o filename : save output to a file\n");
+    printf("  -z : use the words of the input as keys without copying them\n");
     exit(EXIT_FAILURE);
 }
 
@@ -162,12 +181,13 @@ int main(int argc, char *argv[]) {
     int nprocs = 0, map_tasks = 0, ndisp = 5, reduce_tasks = 0;
     int quiet = 0;
     int c;
+    const char *spec = NULL;
     if (argc < 2)
 	usage(argv[0]);
     char *fn = argv[1];
     FILE *fout = NULL;
 
-    while ((c = getopt(argc - 1, argv + 1, "p:s:l:m:r:qao:")) != -1) {
+    while ((c = getopt(argc - 1, argv + 1, "p:s:l:m:r:qao:S:z")) != -1) {
 	switch (c) {
 	case 'p':
 	    nprocs = atoi(optarg);
@@ -181,12 +201,18 @@ int main(int argc, char *argv[]) {
 	case 'r':
 	    reduce_tasks = atoi(optarg);
 	    break;
+	case 'S':
+	    spec = optarg;
+	    break;
 	case 'q':
 	    quiet = 1;
 	    break;
 	case 'a':
 	    alphanumeric = 1;
 	    break;
+	case 'z':
+	    zero_copy = 1;
+	    break;
 	case 'o':
 	    fout = fopen(optarg, "w+");
 	    if (!fout) {
@@ -205,6 +231,10 @@ int main(int argc, char *argv[]) {
     /* get input file */
     wc app(fn, map_tasks);
     app.set_ncore(nprocs);
+    if (spec && !app.set_strategy(spec)) {
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
     app.set_reduce_task(reduce_tasks);
     app.sched_run();
     app.print_stats();
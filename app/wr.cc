@@ -57,15 +57,18 @@ static void usage(const char *prog) {
 	("  -r #reduce tasks : # of reduce tasks (16 tasks per core by default)\n");
     printf("  -l ntops : # of top val. pairs to display\n");
     printf("  -q : quiet output (for batch test)\n");
+    printf("  -S strategy : execution strategy, e.g. mode=metis,map-ds=btree,sort=psrs\n");
+    printf("  -z : use the words of the input as keys without copying them\n");
     exit(EXIT_FAILURE);
 }
 
 int main(int argc, char *argv[]) {
     int nprocs = 0, map_tasks = 0, ndisp = 5, reduce_tasks = 0, quiet = 0;
-    int c;
+    int c, zero_copy = 0;
+    const char *spec = NULL;
     if (argc < 2)
 	usage(argv[0]);
-    while ((c = getopt(argc - 1, argv + 1, "p:l:m:r:q")) != -1) {
+    while ((c = getopt(argc - 1, argv + 1, "p:l:m:r:qS:z")) != -1) {
 	switch (c) {
 	case 'p':
 	    nprocs = atoi(optarg);
@@ -79,9 +82,15 @@ int main(int argc, char *argv[]) {
 	case 'r':
 	    reduce_tasks = atoi(optarg);
 	    break;
+	case 'S':
+	    spec = optarg;
+	    break;
 	case 'q':
 	    quiet = 1;
 	    break;
+	case 'z':
+	    zero_copy = 1;
+	    break;
 	default:
 	    usage(argv[0]);
 	    exit(EXIT_FAILURE);
@@ -92,6 +101,12 @@ int main(int argc, char *argv[]) {
     mapreduce_appbase::initialize();
     wr app(argv[1], map_tasks);
     app.set_ncore(nprocs);
+    if (zero_copy)
+        app.set_zero_copy();
+    if (spec && !app.set_strategy(spec)) {
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
     app.set_group_task(reduce_tasks);
     app.sched_run();
     app.print_stats();
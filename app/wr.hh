@@ -5,15 +5,24 @@
 #include "defsplitter.hh"
 
 struct wr : public map_group {
-    wr(char *d, size_t size, int nsplit) : s_(d, size, nsplit) {}
-    wr(char *f, int nsplit) : s_(f, nsplit) {}
+    wr(char *d, size_t size, int nsplit) : s_(d, size, nsplit), zero_copy_() {}
+    wr(char *f, int nsplit) : s_(f, nsplit), zero_copy_() {}
+    /* @brief: use the words of the input as keys without copying them */
+    void set_zero_copy() {
+        zero_copy_ = true;
+    }
 
-    void map_function(split_t *ma) {
+    void map_function(split_t *ma, emitter &e) {
         char k[1024];
         size_t klen;
         split_word sw(ma);
+        if (zero_copy_) {
+            while (char *w = sw.next(klen))
+                e.map_emit(w, w, klen);
+            return;
+        }
         while (char *index = sw.fill(k, sizeof(k), klen))
-            map_emit(k, index, klen);
+            e.map_emit(k, index, klen);
     }
 
     bool split(split_t *ma, int ncore) {
@@ -23,17 +32,30 @@ struct wr : public map_group {
     int key_compare(const void *k1, const void *k2) {
         return strcmp((const char *)k1, (const char *)k2);
     }
+    bool buffered_map_emit() {
+        return true;
+    }
+    bool stable_map_keys() {
+        return zero_copy_;
+    }
+    bool bulk_free_keys() {
+        return zero_copy_;
+    }
     void *key_copy(void *src, size_t s) {
+        if (zero_copy_)
+            return src;
         char *key = safe_malloc<char>(s + 1);
         memcpy(key, src, s);
         key[s] = 0;
         return key;
     }
     void key_free(void *k) {
-        free(k);
+        if (!zero_copy_)
+            free(k);
     }
   private:
     defsplitter s_;
+    bool zero_copy_;
 };
 
 inline size_t count(xarray<keyvals_len_t> *wc_vals) {
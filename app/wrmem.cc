@@ -52,6 +52,7 @@ static void usage(char *prog) {
     printf("  -l ntops : # of top key/value pairs to display\n");
     printf("  -s inputsize : size of input in MB\n");
     printf("  -q : quiet output (for batch test)\n");
+    printf("  -S strategy : execution strategy, e.g. mode=metis,map-ds=btree,sort=psrs\n");
     exit(EXIT_FAILURE);
 }
 
@@ -60,7 +61,8 @@ int main(int argc, char *argv[]) {
     int nprocs = 0, map_tasks = 0, ndisp = 5, reduce_tasks = 0, quiet = 0;
     uint64_t inputsize = 0x80000000;
     int c;
-    while ((c = getopt(argc, argv, "p:l:m:r:qs:")) != -1) {
+    const char *spec = NULL;
+    while ((c = getopt(argc, argv, "p:l:m:r:qs:S:")) != -1) {
 	switch (c) {
 	case 'p':
 	    nprocs = atoi(optarg);
@@ -77,6 +79,9 @@ int main(int argc, char *argv[]) {
 	case 's':
 	    inputsize = atol(optarg) * 1024 * 1024;
 	    break;
+	case 'S':
+	    spec = optarg;
+	    break;
 	case 'q':
 	    quiet = 1;
 	    break;
@@ -103,6 +108,10 @@ int main(int argc, char *argv[]) {
     mapreduce_appbase::initialize();
     wr app(fdata, inputsize, map_tasks);
     app.set_ncore(nprocs);
+    if (spec && !app.set_strategy(spec)) {
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
     app.set_group_task(reduce_tasks);
     app.sched_run();
     app.print_stats();
@@ -19,6 +19,11 @@
 #include "profile.hh"
 #include "bench.hh"
 #include "predictor.hh"
+#include "hll.hh"
+#include "memstat.hh"
+#include "trace.hh"
+#include "strategy.hh"
+#include "key_dictionary.hh"
 
 struct mapreduce_appbase;
 struct map_bucket_manager_base;
@@ -26,9 +31,118 @@ struct reduce_bucket_manager_base;
 
 struct static_appbase;
 
+/* @brief: a pair passed to emitter::map_emit_batch */
+struct emit_pair {
+    void *key_;
+    void *val_;
+    int keylen_;
+    unsigned hash_;  // set by Metis
+    bool newkey_;    // set by Metis: true if the key was not in the bucket
+};
+
+/* @brief: emits the pairs of a worker thread. Metis creates one for each
+   map, reduce and merge worker, caching the bucket manager, the row of the
+   worker and the current output bucket, so that emitting a pair doesn't
+   look up the thread or branch on the phase. */
+struct emitter {
+    typedef bool (*emit_type)(map_bucket_manager_base *m, size_t row, void *key,
+                              void *val, size_t keylen, unsigned hash);
+    typedef void (*emit_batch_type)(map_bucket_manager_base *m, size_t row,
+                                    emit_pair *ps, size_t n);
+    emitter() : app_(), m_(), emit_(), emit_batch_(), row_(), e_(), de_(), rb_(),
+                dict_(), buffered_(), stable_(), nbuf_(), keyoff_(), cached_() {}
+    /* @brief: same as mapreduce_appbase::map_emit. If the application
+       enables buffered_map_emit, the pair is buffered and inserted
+       with the next batch. */
+    inline void map_emit(void *key, void *val, int key_length);
+    /* @brief: emit @n pairs. The buckets of all pairs are looked up and
+       prefetched before any pair is inserted, which overlaps the cache
+       misses of the lookups. */
+    inline void map_emit_batch(emit_pair *ps, size_t n);
+    /* @brief: insert the buffered pairs */
+    void flush() {
+        if (nbuf_)
+            insert_batch(buf_, nbuf_);
+        nbuf_ = 0;
+        keyoff_ = 0;
+    }
+    /* @brief: insert the pairs of the hot key cache and the buffered pairs */
+    void flush_all() {
+        if (cached_)
+            for (size_t i = 0; i < hot_key_cache_size; ++i) {
+                evict(&cache_[i]);
+                cache_[i].kvs_.reset();
+            }
+        flush();
+    }
+    /* @brief: same as mapreduce_appbase::reduce_emit */
+    void reduce_emit(void *key, void *val) {
+        rb_->push_back(keyval_t(key, val));
+        trace_count_pair();
+    }
+
+  private:
+    friend struct mapreduce_appbase;
+    /* a key in the hot key cache, and the values emitted with it so far
+       combined by map_values_insert */
+    struct hot_key {
+        keyvals_t kvs_;  // kvs_.key_ is NULL, key_ or its interned id
+        void *src_;      // the key to insert: key_, or the stable map key
+        int keylen_;
+        unsigned credit_;
+        char key_[24];
+    };
+    inline void buffer(void *key, void *val, int key_length, unsigned hash);
+    inline void install(hot_key *h, void *key, int key_length, unsigned hash);
+    inline void evict(hot_key *h);
+    inline void insert_batch(emit_pair *ps, size_t n);
+
+    mapreduce_appbase *app_;
+    map_bucket_manager_base *m_;
+    emit_type emit_;   // the emit function of m_
+    emit_batch_type emit_batch_;
+    size_t row_;
+    predictor *e_;     // predictor of this worker if sampling
+    distinct_estimator *de_;  // distinct key estimator of this worker if sampling
+    xarray<keyval_t> *rb_;  // output bucket of the current reduce task
+    key_dictionary *dict_;  // interns the inserted keys if not NULL
+
+    enum { buffer_size = 32, key_buffer_size = 4096 };
+    bool buffered_;
+    bool stable_;  // buffer the pointers of the stable map keys
+    size_t nbuf_;
+    size_t keyoff_;
+    emit_pair buf_[buffer_size];
+    char keys_[key_buffer_size];  // copies of the buffered keys, unless stable_
+
+    // A direct mapped cache of recently emitted keys, which accumulates
+    // the values of a key until another key with the same slot evicts it.
+    // Each hit earns the key a credit, and each miss of the slot spends
+    // one, so that a cold key doesn't evict a hot one. Used with
+    // buffered_map_emit, whose keys can be compared bytewise.
+    enum { hot_key_cache_size = 256, max_credit = 8 };
+    bool cached_;
+    hot_key cache_[hot_key_cache_size];
+};
+
+/* @brief: memory usage of the Metis runs so far */
+struct mem_report {
+    uint64_t nalloc_[mem_nsubsys];  // number of allocations of each subsystem
+    uint64_t bytes_[mem_nsubsys];   // bytes allocated by each subsystem
+    uint64_t sample_peak_rss_;      // peak RSS in bytes of the sampling phase
+    uint64_t peak_rss_[MR_PHASES];  // peak RSS in bytes of each phase
+};
+
 struct mapreduce_appbase {
     mapreduce_appbase();
-    virtual void map_function(split_t *) = 0;
+    /* @brief: user defined map function. Emit pairs with @e; the
+       version without an emitter is still supported. */
+    virtual void map_function(split_t *s, emitter &e) {
+        map_function(s);
+    }
+    virtual void map_function(split_t *) {
+        assert(0 && "Please overload map_function");
+    }
     virtual bool split(split_t *ret, int ncore) = 0;
     virtual int key_compare(const void *, const void *) = 0;
     virtual ~mapreduce_appbase();
@@ -39,6 +153,35 @@ struct mapreduce_appbase {
 
     /* @brief: if you have implemented key_copy, you should also implement key_free */
     virtual void key_free(void *k) {}
+    /* @brief: return true if the keys need not be freed one by one, such
+       as keys that point into the input. Metis then never calls key_free. */
+    virtual bool bulk_free_keys() {
+        return false;
+    }
+
+    /* @brief: return true to let Metis buffer the pairs of map_emit and
+       insert them in batches (see emitter::map_emit_batch). Metis buffers a
+       copy of the key_length bytes at the key pointer, followed by a NUL, so
+       the key must be exactly those bytes and key_copy must copy it.
+       Map-reduce applications also combine the values of recently emitted
+       keys in each core before inserting them (see strategy::hot_keys_). */
+    virtual bool buffered_map_emit() {
+        return false;
+    }
+    /* @brief: with buffered_map_emit, return true if the keys passed to
+       map_emit stay valid and unchanged until the results are freed, such
+       as the words returned by split_word::next. Metis then buffers the
+       key pointers instead of copies, so key_copy may return its argument
+       and the results refer to the input. */
+    virtual bool stable_map_keys() {
+        return false;
+    }
+
+    /* @brief: the index in [0, nkey) of @k, for applications that call
+       set_dense_keys */
+    virtual size_t dense_key(void *k, int length) {
+        assert(0 && "Please overload dense_key");
+    }
 
     /* @brief: default partition function that partition keys into reduce/group buckets */
     virtual unsigned partition(void *k, int length) {
@@ -52,10 +195,46 @@ struct mapreduce_appbase {
     void set_ncore(int ncore) {
         ncore_ = ncore;
     }
+    /* @brief: set how the following runs execute. Metis uses the strategy
+       chosen by configure, updated by the METIS_STRATEGY environment
+       variable (see strategy::parse), by default. */
+    void set_strategy(const strategy &s) {
+        assert(clean_);
+        strategy_ = s;
+    }
+    /* @brief: update the strategy from @spec (see strategy::parse).
+       @return: false if @spec is invalid */
+    bool set_strategy(const char *spec) {
+        assert(clean_);
+        return strategy_.parse(spec);
+    }
+    const strategy &get_strategy() const {
+        return strategy_;
+    }
+    /* @brief: declare that dense_key maps the keys to [0, @nkey). Metis then
+       keeps the values of each key in a per-core array indexed by the key
+       instead of the map data structures, skips sampling, and reduces the
+       keys of all cores in ranges. 0 disables it. */
+    void set_dense_keys(size_t nkey) {
+        assert(clean_ && application_type() != atype_maponly);
+        dense_nkey_ = nkey;
+    }
+    /* @brief: declare that the application does not need the results in
+       the order of final_output_compare. Metis then groups the keys of each
+       reduce task with a hash table instead of sorting them, skips the merge
+       phase, and leaves the results in result_segments_ instead of
+       results_: the output of each reduce task, or the map output of each
+       core for map_only, without copying it. The modes that group the keys
+       by merging the map output return it as one segment. */
+    void set_unordered_output(bool on) {
+        assert(clean_);
+        unordered_output_ = on;
+    }
     static void initialize();
     static void deinitialize();
     int sched_run();
     void print_stats();
+    void get_mem_stats(mem_report *r);
     /* @brief: called in user defined map function. If keycopy function is
         used, Metis calls the keycopy function for each new key, and user
         can free the key when this function returns. */
@@ -66,6 +245,7 @@ struct mapreduce_appbase {
     void reduce_emit(void *key, void *val);
 
   protected:
+    friend struct emitter;
     friend class static_appbase;
     virtual int application_type() = 0;
     virtual void map_values_insert(keyvals_t *kvs, void *v) {
@@ -85,31 +265,81 @@ struct mapreduce_appbase {
     uint64_t sched_sample();
     virtual bool skip_reduce_or_group_phase() = 0;
     virtual void set_final_result() = 0;
-    int map_worker();
-    int reduce_worker();
-    int merge_worker();
+    /* @brief: whether the results are the reduced buckets, or the map
+       output of map_only, unmerged. The merge phase of the map output
+       still groups the keys of the other applications of the single_*
+       modes, and set_final_result hands its output over as one segment. */
+    bool skip_merge_phase() {
+        return unordered_output_ && (application_type() == atype_maponly ||
+                                     !skip_reduce_or_group_phase());
+    }
+    /* @brief: append the map output of map_only to @dst without copying
+       it, one array per chunk (see segarray::transfer_chunks) */
+    void transfer_map_output(xarray<xarray<keyval_t> > *dst);
+    /* @brief: whether the splits can be generated on demand by the map
+       workers, as nothing needs all of them before the map phase */
+    bool lazy_split();
+    split_t *next_map_task(split_t *buf, int *next);
+    int map_worker(emitter &e);
+    int reduce_worker(emitter &e);
+    int merge_worker(emitter &e);
     static void *base_worker(void *arg);
+    static void *prefault_worker(void *arg);
+    static void *parallel_for_worker(void *arg);
+    /* @brief: run @f(this) on cores 0..@ncore - 1 and wait for them */
+    void run_workers(int ncore, void *(*f)(void *));
+    typedef void (*range_function)(void *arg, size_t first, size_t last);
+    /* @brief: call @f(@arg, first, last) for disjoint ranges covering
+       [0, @n), one per core of the worker pool. It runs on the calling
+       thread alone if the pool is gone or the loop is small: @work
+       elements, @n if 0. */
+    void parallel_for(size_t n, range_function f, void *arg, size_t work = 0);
+    static void free_dictionary_range(void *arg, size_t first, size_t last);
+    static void read_input_range(void *arg, size_t first, size_t last);
     void run_phase(int phase, int ncore, uint64_t &t, int first_task = 0);
+    void init_emitter(emitter *e, int row);
+    void set_reduce_bucket(emitter *e, int task);
     map_bucket_manager_base *create_map_bucket_manager(int nrow, int ncol);
+    /* @brief: the number of dense keys if the dense keys are used, or 0 */
+    size_t dense_nkey() const {
+        return strategy_.dense_keys_ ? dense_nkey_ : 0;
+    }
+    /* @brief: true if the map phase inserts into one table shared by all
+       cores (see shared_bucket_manager) */
+    bool shared_table();
+    /* @brief: true if the map phase interns the keys (see key_dictionary) */
+    bool intern_keys();
 
     int nreduce_or_group_task_;
+    strategy strategy_;
+    size_t dense_nkey_;
+    bool unordered_output_;
     enum { min_group_or_reduce_task_per_core = 16,
            max_group_or_reduce_task_per_core = 100 };
     enum { default_sample_hashtable_size = 10000 };
     enum { sample_percent = 5 };
     enum { combiner_threshold = 8 };
     enum { expected_keys_per_bucket = 10 };
+    enum { shared_table_max_keys = 1024 };
+    // smaller loops of parallel_for are not worth waking up the cores
+    enum { parallel_for_min = 1 << 14 };
+    /* emitter of the worker running on this thread */
+    static JTLS emitter *emitter_;
 
   private:
     uint64_t nsample_;
+    size_t predicted_nkey_;  // by the last sampling
     int merge_ncore_;
 
     int ncore_;   
+    uint64_t total_split_time_;  // of splitting before the job
     uint64_t total_sample_time_;
     uint64_t total_map_time_;
     uint64_t total_reduce_time_;
     uint64_t total_merge_time_;
     uint64_t total_real_time_;
+    uint64_t sample_peak_rss_;
+    uint64_t peak_rss_[MR_PHASES];
     bool clean_;
     
     int next_task() {
@@ -118,11 +348,24 @@ struct mapreduce_appbase {
     int next_task_;
     int phase_;
     xarray<split_t> ma_;
+    // whether the map workers call split on demand instead of taking ma_
+    bool lazy_split_;
+    bool split_done_;
+    spinlock split_lock_;
+    // the loop of parallel_for
+    range_function pfor_f_;
+    void *pfor_arg_;
+    size_t pfor_n_;
+    int pfor_ncore_;
+    bool bulk_free_keys_;  // cached bulk_free_keys of the running job
 
     map_bucket_manager_base *m_;
     map_bucket_manager_base *sample_;
     bool sampling_;
-    predictor e_[JOS_NCPU];
+    bool map_output_reduced_;  // map -> merge -> reduce with mergesort
+    key_dictionary *dict_;  // if the keys are interned
+    predictor *e_;  // one per core, while sampling
+    distinct_estimator *de_;  // one per core, while sampling
 };
 
 struct static_appbase {
@@ -149,17 +392,52 @@ struct static_appbase {
     static int pair_comp(const void *p1, const void *p2) {
         const T *x1 = reinterpret_cast<const T *>(p1);
         const T *x2 = reinterpret_cast<const T *>(p2);
-        return the_app_->key_compare(x1->key_, x2->key_);
+        return key_compare(x1->key_, x2->key_);
     }
     static int key_compare(const void *k1, const void *k2) {
+        if (the_app_->dict_) {
+            const uintptr_t x1 = uintptr_t(k1), x2 = uintptr_t(k2);
+            return x1 < x2 ? -1 : x1 > x2;
+        }
         return the_app_->key_compare(k1, k2);
     }
     static void *key_copy(void *k, size_t keylen) {
-        return the_app_->key_copy(k, keylen);
+        if (the_app_->dict_)
+            return k;
+        return user_key_copy(k, keylen);
+    }
+    /* @brief: the key of the application, which key_copy would return */
+    static void *user_key_copy(void *k, size_t keylen) {
+        void *nk = the_app_->key_copy(k, keylen);
+        if (nk != k)
+            mem_account(mem_keys, keylen);
+        return nk;
+    }
+    /* @brief: the key that Metis stores for the interned key @id */
+    static void *id_key(uint32_t id) {
+        return reinterpret_cast<void *>(uintptr_t(id));
+    }
+    /* @brief: the bytes of the key @k for the application, which
+       owns it only if the keys are not interned */
+    static void *user_key(void *k) {
+        if (the_app_->dict_)
+            return the_app_->dict_->key(uintptr_t(k));
+        return k;
     }
     static int application_type() {
         return the_app_->application_type();
     }
+    static const strategy &get_strategy() {
+        return the_app_->strategy_;
+    }
+    /* @brief: whether the results skip the merge phase (see
+       mapreduce_appbase::set_unordered_output) */
+    static bool unordered_output() {
+        return the_app_->skip_merge_phase();
+    }
+    static size_t dense_key(void *k, size_t keylen) {
+        return the_app_->dense_key(k, keylen);
+    }
     static void map_values_insert(keyvals_t *dst, void *v) {
         return the_app_->map_values_insert(dst, v);
     }
@@ -171,10 +449,124 @@ struct static_appbase {
         the_app_ = app;
     }
     static void key_free(void *k) {
-        the_app_->key_free(k);
+        if (!the_app_->dict_ && !the_app_->bulk_free_keys_)
+            the_app_->key_free(k);
     }
   private:
     static mapreduce_appbase *the_app_;
 };
 
+inline void emitter::map_emit(void *key, void *val, int key_length) {
+    if (!buffered_) {
+        unsigned hash = app_->partition(key, key_length);
+        bool newkey = emit_(m_, row_, key, val, key_length, hash);
+        if (e_) {
+            e_->onepair(newkey);
+            de_->onepair(newkey, hash);
+        }
+        trace_count_pair();
+        return;
+    }
+    unsigned hash = app_->partition(key, key_length);
+    if (cached_ && size_t(key_length) < sizeof(cache_[0].key_)) {
+        hot_key *h = &cache_[hash % hot_key_cache_size];
+        if (!h->kvs_.key_) {
+            install(h, key, key_length, hash);
+        } else if (h->keylen_ != key_length || h->kvs_.hash != hash ||
+                   memcmp(h->key_, key, key_length)) {
+            // a key that keeps hitting its slot survives some misses
+            if (h->credit_) {
+                --h->credit_;
+                buffer(key, val, key_length, hash);
+                return;
+            }
+            evict(h);
+            install(h, key, key_length, hash);
+        } else if (h->credit_ < max_credit) {
+            ++h->credit_;
+        }
+        static_appbase::map_values_insert(&h->kvs_, val);
+        return;
+    }
+    buffer(key, val, key_length, hash);
+}
+
+inline void emitter::buffer(void *key, void *val, int key_length, unsigned hash) {
+    if (stable_) {
+        if (nbuf_ == buffer_size)
+            flush();
+        emit_pair &p = buf_[nbuf_++];
+        p.key_ = key;
+        p.val_ = val;
+        p.keylen_ = key_length;
+        p.hash_ = hash;
+        return;
+    }
+    if (nbuf_ == buffer_size || keyoff_ + key_length + 1 > key_buffer_size)
+        flush();
+    if (key_length + 1 > key_buffer_size) {
+        emit_pair p = {key, val, key_length, hash, false};
+        insert_batch(&p, 1);
+        return;
+    }
+    emit_pair &p = buf_[nbuf_++];
+    p.key_ = &keys_[keyoff_];
+    memcpy(p.key_, key, key_length);
+    keys_[keyoff_ + key_length] = 0;
+    keyoff_ += key_length + 1;
+    p.val_ = val;
+    p.keylen_ = key_length;
+    p.hash_ = hash;
+}
+
+inline void emitter::install(hot_key *h, void *key, int key_length, unsigned hash) {
+    // map_emit caches only the keys that fit with their NUL
+    assert(key_length >= 0 && size_t(key_length) < sizeof(h->key_));
+    h->keylen_ = std::min(key_length, int(sizeof(h->key_)) - 1);
+    memcpy(h->key_, key, h->keylen_);
+    h->key_[h->keylen_] = 0;
+    h->src_ = stable_ ? key : h->key_;
+    h->credit_ = 0;
+    // map_values_insert passes the key to combine_function as it would
+    // find it in the map data structures
+    h->kvs_.key_ = dict_ ? static_appbase::id_key(dict_->intern(key, key_length, hash, stable_))
+                         : h->key_;
+    h->kvs_.hash = hash;
+}
+
+/* @brief: pass the values of @h to the buffer, one pair each */
+inline void emitter::evict(hot_key *h) {
+    if (!h->kvs_.key_)
+        return;
+    if (h->kvs_.multiplex()) {
+        buffer(h->src_, h->kvs_.multiplex_value(), h->keylen_, h->kvs_.hash);
+        h->kvs_.init();
+    } else {
+        for (size_t i = 0; i < h->kvs_.size(); ++i)
+            buffer(h->src_, *h->kvs_.at(i), h->keylen_, h->kvs_.hash);
+        h->kvs_.trim(0);
+    }
+    h->kvs_.key_ = NULL;
+}
+
+inline void emitter::map_emit_batch(emit_pair *ps, size_t n) {
+    for (size_t i = 0; i < n; ++i)
+        ps[i].hash_ = app_->partition(ps[i].key_, ps[i].keylen_);
+    insert_batch(ps, n);
+}
+
+inline void emitter::insert_batch(emit_pair *ps, size_t n) {
+    if (dict_)
+        for (size_t i = 0; i < n; ++i)
+            ps[i].key_ = static_appbase::id_key(
+                dict_->intern(ps[i].key_, ps[i].keylen_, ps[i].hash_, stable_));
+    emit_batch_(m_, row_, ps, n);
+    if (e_)
+        for (size_t i = 0; i < n; ++i) {
+            e_->onepair(ps[i].newkey_);
+            de_->onepair(ps[i].newkey_, ps[i].hash_);
+        }
+    trace_npair_ += n;
+}
+
 #endif
@@ -24,14 +24,25 @@
 #include "application.hh"
 #include "bench.hh"
 #include "thread.hh"
+#include "cpumap.hh"
 #include "reduce_bucket_manager.hh"
 #include "map_bucket_manager.hh"
+#include "dense_bucket_manager.hh"
+#include "shared_bucket_manager.hh"
 #include "btree.hh"
 #include "array.hh"
+#include "trace.hh"
+#include "hugepage.hh"
 
 mapreduce_appbase *static_appbase::the_app_ = NULL;
+JTLS emitter *mapreduce_appbase::emitter_ = NULL;
 
 void static_appbase::internal_reduce_emit(keyvals_t &p) {
+    if (key_dictionary *d = the_app_->dict_) {
+        // the output owns a copy of the key
+        const uint32_t id = uintptr_t(p.key_);
+        p.key_ = user_key_copy(d->source(id), d->length(id));
+    }
     if (application_type() == atype_mapreduce)
         static_cast<map_reduce *>(the_app_)->internal_reduce_emit(p);
     else
@@ -44,16 +55,28 @@ void pprint(const char *key, uint64_t v, const char *delim) {
 }
 
 void cprint(const char *key, uint64_t v, const char *delim) {
-    pprint(key, cycle_to_ms(v), delim);
+    pprint(key, clock_to_ms(v), delim);
 }
 }
 
 mapreduce_appbase::mapreduce_appbase() 
-    : nsample_(), merge_ncore_(), ncore_(),
+    : nreduce_or_group_task_(), strategy_(strategy::defaults()), dense_nkey_(),
+      unordered_output_(false),
+      nsample_(), predicted_nkey_(),
+      merge_ncore_(), ncore_(), total_split_time_(),
       total_sample_time_(), total_map_time_(), total_reduce_time_(),
-      total_merge_time_(), total_real_time_(), clean_(true),
-      next_task_(), phase_(), m_(NULL), sample_(NULL), sampling_(false) {
-    bzero(e_, sizeof(e_));
+      total_merge_time_(), total_real_time_(), sample_peak_rss_(),
+      clean_(true), next_task_(), phase_(), lazy_split_(false),
+      split_done_(false), pfor_f_(NULL), pfor_arg_(NULL), pfor_n_(),
+      pfor_ncore_(), bulk_free_keys_(false), m_(NULL), sample_(NULL),
+      sampling_(false), map_output_reduced_(false), dict_(NULL), e_(NULL),
+      de_(NULL) {
+    bzero(peak_rss_, sizeof(peak_rss_));
+    if (const char *spec = getenv("METIS_STRATEGY"))
+        if (!strategy_.parse(spec)) {
+            fprintf(stderr, "invalid METIS_STRATEGY: %s\n", spec);
+            exit(EXIT_FAILURE);
+        }
 }
 
 mapreduce_appbase::~mapreduce_appbase() {
@@ -62,23 +85,38 @@ mapreduce_appbase::~mapreduce_appbase() {
 
 void mapreduce_appbase::initialize() {
     threadinfo::initialize();
+    tsc_calibrated();
+    if (const char *path = getenv("METIS_TRACE"))
+        trace_enable(path);
+    if (profile_by_default || getenv("METIS_PROFILE"))
+        prof_enable();
 }
 
 void mapreduce_appbase::deinitialize() {
+    trace_finalize();
     mthread_finalize();
 }
 
 map_bucket_manager_base *mapreduce_appbase::create_map_bucket_manager(int nrow, int ncol) {
-    enum { index_append, index_btree, index_array };
-    int index = (application_type() == atype_maponly) ? index_append : DEFAULT_MAP_DS;
     map_bucket_manager_base *m = NULL;
+    if (dense_nkey()) {
+        m = new dense_bucket_manager(dense_nkey());
+        m->global_init(nrow, ncol);
+        return m;
+    }
+    if (!sampling_ && shared_table()) {
+        m = new shared_bucket_manager;
+        m->global_init(nrow, ncol);
+        return m;
+    }
+    // map-only applications keep the pairs in emitting order
+    int index = (application_type() == atype_maponly) ? index_append : strategy_.map_ds();
     switch (index) {
     case index_append:
-#ifdef SINGLE_APPEND_GROUP_FIRST
-        m = new map_bucket_manager<false, keyval_arr_t, keyvals_t>;
-#else
-        m = new map_bucket_manager<false, keyval_arr_t, keyval_t>;
-#endif
+        if (application_type() != atype_maponly && strategy_.group_first())
+            m = new map_bucket_manager<false, keyval_arr_t, keyvals_t>;
+        else
+            m = new map_bucket_manager<false, keyval_arr_t, keyval_t>;
         break;
     case index_btree:
         typedef btree_param<keyvals_t, static_appbase::key_comparator, 
@@ -95,21 +133,102 @@ map_bucket_manager_base *mapreduce_appbase::create_map_bucket_manager(int nrow,
     return m;
 };
 
-int mapreduce_appbase::map_worker() {
+bool mapreduce_appbase::shared_table() {
+    // the shared table has no output for the merge phase
+    if (application_type() == atype_maponly || strategy_.map_merge_reduce())
+        return false;
+    switch (strategy_.shared_table_) {
+    case shared_table_off:
+        return false;
+    case shared_table_on:
+        return true;
+    default:
+        // a single core gains nothing from sharing but pays for the locks
+        return ncore_ > 1 && nsample_ && predicted_nkey_ <= shared_table_max_keys;
+    }
+}
+
+bool mapreduce_appbase::intern_keys() {
+    // the keys must be bytes, and the dense keys are already integers
+    return strategy_.intern_keys_ && buffered_map_emit() &&
+        application_type() != atype_maponly && !dense_nkey();
+}
+
+void mapreduce_appbase::init_emitter(emitter *e, int row) {
+    e->app_ = this;
+    e->m_ = sampling_ ? sample_ : m_;
+    e->emit_ = e->m_ ? e->m_->emit_function() : NULL;
+    e->emit_batch_ = e->m_ ? e->m_->emit_batch_function() : NULL;
+    e->buffered_ = buffered_map_emit();
+    e->stable_ = e->buffered_ && stable_map_keys();
+    e->dict_ = dict_;
+    // the predictor counts the pairs inserted while sampling
+    e->cached_ = e->buffered_ && !sampling_ && strategy_.hot_keys_ &&
+        application_type() == atype_mapreduce;
+    e->row_ = row;
+    e->e_ = sampling_ ? &e_[row] : NULL;
+    e->de_ = sampling_ ? &de_[row] : NULL;
+    emitter_ = e;
+}
+
+void mapreduce_appbase::set_reduce_bucket(emitter *e, int task) {
+    reduce_bucket_manager_base *rb = get_reduce_bucket_manager();
+    rb->set_current_reduce_task(task);
+    if (application_type() == atype_mapreduce)
+        e->rb_ = static_cast<reduce_bucket_manager<keyval_t> *>(rb)->get(task);
+}
+
+bool mapreduce_appbase::lazy_split() {
+    // sampling takes splits from all over the input, and prefault touches
+    // all of them
+    const bool sample = !skip_reduce_or_group_phase() &&
+        !nreduce_or_group_task_ && !dense_nkey();
+    return !sample && !strategy_.prefault_;
+}
+
+/* @brief: the next split to map, and its index in @next: one of ma_, or
+   one that the application splits into @buf on demand.
+   @return: NULL if no split is left */
+split_t *mapreduce_appbase::next_map_task(split_t *buf, int *next) {
+    if (!lazy_split_) {
+        *next = next_task();
+        return *next < int(ma_.size()) ? ma_.at(*next) : NULL;
+    }
+    bzero(buf, sizeof(*buf));
+    split_lock_.lock();
+    bool more = !split_done_ && split(buf, ncore_);
+    if (more) {
+        *next = ma_.size();
+        ma_.push_back(*buf);
+    } else {
+        split_done_ = true;
+    }
+    split_lock_.unlock();
+    return more ? buf : NULL;
+}
+
+int mapreduce_appbase::map_worker(emitter &e) {
     threadinfo *ti = threadinfo::current();
     (sampling_ ? sample_ : m_)->per_worker_init(ti->cur_core_);
     if (!sampling_ && sample_)
         m_->rehash(ti->cur_core_, sample_);
+    const int phase = sampling_ ? int(trace_sample) : int(MAP);
     int n, next;
-    for (n = 0; (next = next_task()) < int(ma_.size()); ++n) {
-	map_function(ma_.at(next));
+    split_t buf;
+    for (n = 0; split_t *ma = next_map_task(&buf, &next); ++n) {
+        trace_scope ts(trace_task, phase, next);
+        if (sampling_)
+            de_[ti->cur_core_].task_start(next, nsample_);
+	map_function(ma, e);
+        e.flush();
         if (sampling_)
 	    e_[ti->cur_core_].task_finished();
     }
-    if (!sampling_ && skip_reduce_or_group_phase()) {
+    e.flush_all();
+    if (!sampling_ && skip_reduce_or_group_phase() &&
+        !(application_type() == atype_maponly && skip_merge_phase())) {
         m_->prepare_merge(ti->cur_core_);
         if (application_type() == atype_maponly) {
-#ifndef SINGLE_APPEND_GROUP_FIRST
             typedef map_bucket_manager<false, keyval_arr_t, keyval_t> expected_mtype;
             expected_mtype* m = static_cast<expected_mtype*>(m_);
             auto output = m->get_output(ti->cur_core_);
@@ -119,33 +238,46 @@ int mapreduce_appbase::map_worker() {
             expected_rtype *x = static_cast<expected_rtype *>(rb);
             assert(x);
             x->set(ti->cur_core_, output);
-#endif
         }
     }
     return n;
 }
 
-int mapreduce_appbase::reduce_worker() {
+void mapreduce_appbase::transfer_map_output(xarray<xarray<keyval_t> > *dst) {
+    assert(application_type() == atype_maponly);
+    typedef map_bucket_manager<false, keyval_arr_t, keyval_t> expected_mtype;
+    expected_mtype *m = static_cast<expected_mtype *>(m_);
+    for (size_t i = 0; i < m->nrow(); ++i)
+        m->transfer_output_chunks(i, dst);
+}
+
+int mapreduce_appbase::reduce_worker(emitter &e) {
     int n, next;
     for (n = 0; (next = next_task()) < nreduce_or_group_task_; ++n) {
-        get_reduce_bucket_manager()->set_current_reduce_task(next);
+        trace_scope ts(trace_task, REDUCE, next);
+        set_reduce_bucket(&e, next);
 	m_->do_reduce_task(next);
     }
     return n;
 }
 
-int mapreduce_appbase::merge_worker() {
+int mapreduce_appbase::merge_worker(emitter &e) {
     reduce_bucket_manager_base *r = get_reduce_bucket_manager();
     threadinfo *ti = threadinfo::current();
-    if (application_type() == atype_maponly || !skip_reduce_or_group_phase())
-	r->merge_reduced_buckets(merge_ncore_, ti->cur_core_);
-    else {
-        r->set_current_reduce_task(ti->cur_core_);
-        // must use psrs
+    if (application_type() != atype_maponly && skip_reduce_or_group_phase() &&
+        !map_output_reduced_) {
+        // sort the output of the map phase and reduce it into reduce
+        // bucket ti->cur_core_
+        set_reduce_bucket(&e, ti->cur_core_);
+        if (!strategy_.psrs_) {
+            // sched_run merges the reduced buckets in the following phases
+            m_->mergesort_output_and_reduce(merge_ncore_, ti->cur_core_);
+            return 1;
+        }
         m_->psrs_output_and_reduce(merge_ncore_, ti->cur_core_);
-        // merge reduced buckets
-	r->merge_reduced_buckets(merge_ncore_, ti->cur_core_);
     }
+    // merge reduced buckets
+    r->merge_reduced_buckets(merge_ncore_, ti->cur_core_);
     return 1;
 }
 
@@ -153,63 +285,148 @@ void *mapreduce_appbase::base_worker(void *x) {
     mapreduce_appbase *app = (mapreduce_appbase *)x;
     threadinfo *ti = threadinfo::current();
     prof_worker_start(app->phase_, ti->cur_core_);
+    trace_scope ts(trace_worker, app->sampling_ ? trace_sample : app->phase_);
+    emitter e;
+    app->init_emitter(&e, ti->cur_core_);
     int n = 0;
     const char *name = NULL;
     switch (app->phase_) {
-    case MAP:
-        n = app->map_worker();
+    case MAP: {
+        mem_scope ms(mem_map_ds);
+        n = app->map_worker(e);
         name = "map";
         break;
-    case REDUCE:
-        n = app->reduce_worker();
+    }
+    case REDUCE: {
+        mem_scope ms(mem_reduce);
+        n = app->reduce_worker(e);
         name = "reduce";
         break;
-    case MERGE:
-        n = app->merge_worker();
+    }
+    case MERGE: {
+        mem_scope ms(mem_merge);
+        n = app->merge_worker(e);
         name = "merge";
         break;
+    }
     default:
         assert(0);
     }
     dprintf("total %d %s tasks executed in thread %ld(%d)\n",
 	    n, name, pthread_self(), ti->cur_core_);
+    ts.set_task(n);
+    emitter_ = NULL;
     prof_worker_end(app->phase_, ti->cur_core_);
     return 0;
 }
 
+/* @brief: touch each page of the splits of this core, so that the map
+   phase does not take the page faults. The inputs that the workers read
+   into huge pages are populated already. */
+void *mapreduce_appbase::prefault_worker(void *x) {
+    mapreduce_appbase *app = (mapreduce_appbase *)x;
+    const int core = threadinfo::current()->cur_core_;
+    char sum = 0;
+    for (size_t i = core; i < app->ma_.size(); i += app->ncore_) {
+        const volatile char *d = (const char *)app->ma_[i].data;
+        if (huge_page_file_read(app->ma_[i].data))
+            continue;
+        for (size_t off = 0; off < app->ma_[i].length; off += JOS_PAGESIZE)
+            sum += d[off];
+    }
+    return int2ptr(sum);
+}
+
+void mapreduce_appbase::run_workers(int ncore, void *(*f)(void *)) {
+    xarray<pthread_t> tid(ncore);
+    for (int i = 0; i < ncore; ++i) {
+        if (i == main_core)
+            continue;
+        mthread_create(&tid[i], i, f, this);
+    }
+    mthread_create(&tid[main_core], main_core, f, this);
+    for (int i = 0; i < ncore; ++i) {
+        if (i == main_core)
+            continue;
+        void *ret;
+        mthread_join(tid[i], i, &ret);
+    }
+}
+
+void *mapreduce_appbase::parallel_for_worker(void *x) {
+    mapreduce_appbase *app = (mapreduce_appbase *)x;
+    const size_t core = threadinfo::current()->cur_core_;
+    const size_t n = app->pfor_n_, ncore = app->pfor_ncore_;
+    app->pfor_f_(app->pfor_arg_, n * core / ncore, n * (core + 1) / ncore);
+    return NULL;
+}
+
+void mapreduce_appbase::parallel_for(size_t n, range_function f, void *arg,
+                                     size_t work) {
+    const int ncore = std::min(ncore_, mthread_ncore());
+    if (ncore <= 1 || n < 2 || (work ? work : n) < parallel_for_min) {
+        f(arg, 0, n);
+        return;
+    }
+    pfor_f_ = f;
+    pfor_arg_ = arg;
+    pfor_n_ = n;
+    pfor_ncore_ = ncore;
+    run_workers(ncore, parallel_for_worker);
+}
+
+void mapreduce_appbase::read_input_range(void *, size_t first, size_t last) {
+    huge_page_read_pending(first, last);
+}
+
+void mapreduce_appbase::free_dictionary_range(void *arg, size_t first, size_t last) {
+    ((key_dictionary *)arg)->free_keys(first, last);
+}
+
 void mapreduce_appbase::run_phase(int phase, int ncore, uint64_t &t, int first_task) {
-    uint64_t t0 = read_tsc();
+    mem_reset_peak_rss();
+    uint64_t t0 = read_clock();
     prof_phase_init();
-    pthread_t tid[JOS_NCPU];
     phase_ = phase;
     next_task_ = first_task;
-    for (int i = 0; i < ncore; ++i) {
-	if (i == main_core)
-	    continue;
-	mthread_create(&tid[i], i, base_worker, this);
-    }
-    mthread_create(&tid[main_core], main_core, base_worker, this);
-    for (int i = 0; i < ncore; ++i) {
-	if (i == main_core)
-	    continue;
-	void *ret;
-	mthread_join(tid[i], i, &ret);
+    {
+        trace_scope ts(trace_phase, sampling_ ? trace_sample : phase);
+        run_workers(ncore, base_worker);
     }
     prof_phase_end();
-    t += read_tsc() - t0;
+    t += read_clock() - t0;
+    uint64_t &peak = sampling_ ? sample_peak_rss_ : peak_rss_[phase];
+    peak = std::max(peak, mem_peak_rss());
 }
 
 size_t mapreduce_appbase::sched_sample() {
     nsample_ = std::max(size_t(1), sample_percent * ma_.size() / 100);
     const size_t nma = ma_.size();
     assert(nma);
+    // sample splits spread evenly over the input, moved to the front of ma_
+    for (size_t i = 0; i < nsample_; ++i)
+        std::swap(ma_[i], ma_[(2 * i + 1) * nma / (2 * nsample_)]);
     ma_.trim(nsample_);
 
     sampling_ = true;
+    mem_scope ms(mem_map_ds);
     sample_ = create_map_bucket_manager(ncore_, default_sample_hashtable_size);
+    e_ = new_aligned_array<predictor>(ncore_);
+    bzero(e_, sizeof(*e_) * ncore_);
+    de_ = safe_malloc<distinct_estimator>(ncore_);
+    for (int i = 0; i < ncore_; ++i)
+        de_[i].init();
     run_phase(MAP, ncore_, total_sample_time_);
-    const size_t predicted_nkey = predict_nkey(e_, ncore_, nma);
-    size_t predicted_ntask = predicted_nkey / expected_keys_per_bucket;
+    // the linear extrapolation of the new key rate bounds the estimate from
+    // above, in case the sample is too small to fit Heaps' law
+    predicted_nkey_ = predict_nkey(e_, ncore_, nma);
+    if (size_t d = distinct_estimator::predict(de_, ncore_, nma, nsample_))
+        predicted_nkey_ = std::min(predicted_nkey_, d);
+    delete_aligned_array(e_, ncore_);
+    e_ = NULL;
+    free(de_);
+    de_ = NULL;
+    size_t predicted_ntask = predicted_nkey_ / expected_keys_per_bucket;
     predicted_ntask = std::max(predicted_ntask, size_t(ncore_) * min_group_or_reduce_task_per_core);
     predicted_ntask = std::min(predicted_ntask, size_t(ncore_) * max_group_or_reduce_task_per_core);
     ma_.trim(nma, true);
@@ -222,31 +439,61 @@ int mapreduce_appbase::sched_run() {
     static_appbase::set_app(this);
     assert(clean_);
     clean_ = false;
-    const int max_ncore = get_core_count();
-    assert(ncore_ <= max_ncore);
-    if (!ncore_)
+    // no more workers than the cpus the process may use
+    const int max_ncore = cpumap_ncpu();
+    if (!ncore_ || ncore_ > max_ncore)
 	ncore_ = max_ncore;
 
     verify_before_run();
+    bulk_free_keys_ = bulk_free_keys();
     // initialize threads
+    mthread_set_placement(strategy_.placement_);
     mthread_init(ncore_);
-
-    // pre-split
+    // the pool of the first job runs the later ones too
+    ncore_ = std::min(ncore_, mthread_ncore());
+
+    uint64_t real_start = read_clock();
+    // the splits look at the inputs mapped for huge pages, so the workers
+    // read them first
+    if (const size_t n = huge_page_pending_chunks()) {
+        parallel_for(n, read_input_range, NULL, n * huge_page_size);
+        huge_page_pending_done();
+        total_split_time_ += read_clock() - real_start;
+    }
     ma_.clear();
-    split_t ma;
-    bzero(&ma, sizeof(ma));
-    while (split(&ma, ncore_)) {
-        ma_.push_back(ma);
+    split_done_ = false;
+    lazy_split_ = lazy_split();
+    if (!lazy_split_) {
+        // pre-split
+        const uint64_t t0 = read_clock();
+        split_t ma;
         bzero(&ma, sizeof(ma));
+        while (split(&ma, ncore_)) {
+            ma_.push_back(ma);
+            bzero(&ma, sizeof(ma));
+        }
+        split_done_ = true;
+        total_split_time_ += read_clock() - t0;
     }
-    uint64_t real_start = read_tsc();
+    if (strategy_.prefault_) {
+        // not counted as the job
+        uint64_t t0 = read_clock();
+        run_workers(ncore_, prefault_worker);
+        real_start += read_clock() - t0;
+    }
+    if (intern_keys())
+        dict_ = new key_dictionary;
     // get the number of reduce tasks by sampling if needed
     if (skip_reduce_or_group_phase()) {
+        mem_scope ms(mem_map_ds);
         m_ = create_map_bucket_manager(ncore_, 1);
         get_reduce_bucket_manager()->init(ncore_);
     } else {
+        if (!nreduce_or_group_task_ && dense_nkey())
+            nreduce_or_group_task_ = std::min(dense_nkey(), size_t(ncore_));
 	if (!nreduce_or_group_task_)
 	    nreduce_or_group_task_ = sched_sample();
+        mem_scope ms(mem_map_ds);
         m_ = create_map_bucket_manager(ncore_, nreduce_or_group_task_);
         get_reduce_bucket_manager()->init(nreduce_or_group_task_);
     }
@@ -258,35 +505,45 @@ int mapreduce_appbase::sched_run() {
     if (!skip_reduce_or_group_phase())
 	run_phase(REDUCE, ncore_, reduce_time);
     // merge phase
-    const int use_psrs = USE_PSRS;
-    if (use_psrs) {
+    if (skip_merge_phase()) {
+        // set_final_result lays the reduced buckets out back to back
+    } else if (strategy_.psrs_) {
         merge_ncore_ = ncore_;
 	run_phase(MERGE, merge_ncore_, merge_time);
     } else {
         reduce_bucket_manager_base *r = get_reduce_bucket_manager();
-	merge_ncore_ = std::min(int(r->size()) / 2, ncore_);
-	while (r->size() > 1) {
+        if (application_type() != atype_maponly && skip_reduce_or_group_phase()) {
+            merge_ncore_ = ncore_;
+            run_phase(MERGE, merge_ncore_, merge_time);
+            map_output_reduced_ = true;
+        }
+        // merge at least once to sort a single bucket in the output order
+	merge_ncore_ = std::max(1, std::min(int(r->size()) / 2, ncore_));
+	do {
 	    run_phase(MERGE, merge_ncore_, merge_time);
             r->trim(merge_ncore_);
 	    merge_ncore_ /= 2;
-	}
+	} while (r->size() > 1);
     }
     set_final_result();
     total_map_time_ += map_time;
     total_reduce_time_ += reduce_time;
     total_merge_time_ += merge_time;
-    total_real_time_ += read_tsc() - real_start;
+    total_real_time_ += read_clock() - real_start;
+    trace_dump(ncore_);
     reset();  // result everything except for results_
     return 0;
 }
 
 void mapreduce_appbase::print_stats(void) {
     prof_print(ncore_);
-    uint64_t sum_time = total_sample_time_ + total_map_time_ + 
+    uint64_t sum_time = total_split_time_ + total_sample_time_ + total_map_time_ +
                         total_reduce_time_ + total_merge_time_;
 
+    std::cout << "Strategy: " << strategy_.to_string() << "\n";
     std::cout << "Runtime in millisecond [" << ncore_ << " cores]\n\t";
 #define SEP "\t"
+    cprint("Split:", total_split_time_, SEP);
     cprint("Sample:", total_sample_time_, SEP);
     cprint("Map:", total_map_time_, SEP);
     cprint("Reduce:", total_reduce_time_, SEP);
@@ -302,22 +559,33 @@ void mapreduce_appbase::print_stats(void) {
 	pprint("Map:", ma_.size() - nsample_, SEP);
 	pprint("Reduce:", nreduce_or_group_task_, "\n");
     }
+
+    mem_report r;
+    get_mem_stats(&r);
+    std::cout << "Memory allocated in KB (number of allocations)\n";
+    for (int i = 0; i < mem_nsubsys; ++i)
+        std::cout << "\t" << mem_subsys_name(i) << ":\t" << (r.bytes_[i] >> 10)
+                  << " (" << r.nalloc_[i] << ")";
+    std::cout << "\nPeak RSS in KB\n\t";
+    pprint("Sample:", r.sample_peak_rss_ >> 10, SEP);
+    pprint("Map:", r.peak_rss_[MAP] >> 10, SEP);
+    pprint("Reduce:", r.peak_rss_[REDUCE] >> 10, SEP);
+    pprint("Merge:", r.peak_rss_[MERGE] >> 10, "\n");
+}
+
+void mapreduce_appbase::get_mem_stats(mem_report *r) {
+    mem_sum(r->nalloc_, r->bytes_);
+    r->sample_peak_rss_ = sample_peak_rss_;
+    memcpy(r->peak_rss_, peak_rss_, sizeof(peak_rss_));
 }
 
 void mapreduce_appbase::map_emit(void *k, void *v, int keylen) {
-    unsigned hash = partition(k, keylen);
-    threadinfo *ti = threadinfo::current();
-    bool newkey = (sampling_ ? sample_ : m_)->emit(ti->cur_core_, k, v, keylen, hash);
-    if (sampling_)
-        e_[ti->cur_core_].onepair(newkey);
+    emitter_->map_emit(k, v, keylen);
 }
 
 void mapreduce_appbase::reduce_emit(void *k, void *v) {
-    reduce_bucket_manager_base *rb = get_reduce_bucket_manager();
-    typedef reduce_bucket_manager<keyval_t> expected_type;
-    expected_type *x = static_cast<expected_type *>(rb);
-    assert(x);
-    x->emit(keyval_t(k, v));
+    assert(application_type() == atype_mapreduce);
+    emitter_->reduce_emit(k, v);
 }
 
 void mapreduce_appbase::reset() {
@@ -330,9 +598,15 @@ void mapreduce_appbase::reset() {
         delete sample_;
         sample_ = NULL;
     }
-    bzero(e_, sizeof(e_));
+    if (dict_) {
+        parallel_for(dict_->id_end(), free_dictionary_range, dict_);
+        delete dict_;
+        dict_ = NULL;
+    }
+    map_output_reduced_ = false;
     clean_ = true;
     nsample_ = 0;
+    predicted_nkey_ = 0;
 }
 
 
@@ -340,12 +614,10 @@ void mapreduce_appbase::reset() {
 void map_reduce::internal_reduce_emit(keyvals_t &p) {
     if (has_value_modifier()) {
         assert(p.size() == 1);
-        keyval_t x(p.key_, p.multiplex_value());
-	rb_.emit(x);
-        x.init();
+        emitter_->reduce_emit(p.key_, p.multiplex_value());
         p.init();
     } else {
-        reduce_function(p.key_, p.array(), p.size());
+        reduce_function(p.key_, p.array(), p.size(), *emitter_);
         p.trim(0);
     }
 }
@@ -360,7 +632,8 @@ void map_reduce::map_values_insert(keyvals_t *kvs, void *v) {
     }
     kvs->push_back(v);
     if (kvs->size() >= combiner_threshold) {
-	size_t newn = combine_function(kvs->key_, kvs->array(), kvs->size());
+	size_t newn = combine_function(static_appbase::user_key(kvs->key_),
+                                       kvs->array(), kvs->size());
         assert(newn <= kvs->size());
         kvs->trim(newn);
     }
@@ -383,8 +656,10 @@ void map_reduce::map_values_move(keyvals_t *dst, keyvals_t *src) {
 
 /** === map_group === */
 void map_group::internal_reduce_emit(keyvals_t &p) {
-    keyvals_len_t x(p.key_, p.array(), p.size());
+    const size_t n = p.size();
+    keyvals_len_t x(p.key_, p.release(), n);
     rb_.emit(x);
+    trace_count_pair();
     x.init();
     p.init();
 }
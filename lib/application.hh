@@ -27,6 +27,12 @@ struct map_bucket_manager_base;
 template <typename T, int at>
 struct app_impl_base : public mapreduce_appbase {
     xarray<T> results_;
+    /* the results when the application sets set_unordered_output, in
+       every mode: one array per reduce task, or per chunk of the map
+       output of a core for map_only, in no particular order, or a single
+       array when the merge phase grouped the keys. results_ is then
+       empty. */
+    xarray<xarray<T> > result_segments_;
 
     int application_type() {
         return at;
@@ -38,17 +44,39 @@ struct app_impl_base : public mapreduce_appbase {
     virtual int final_output_compare(const T *p1, const T *p2) {
         return this->key_compare(p1->key_, p2->key_);
     }
+    /* @brief: the number of results of the last run, in results_ or in
+       result_segments_ */
+    size_t nresult() {
+        size_t n = results_.size();
+        for (size_t i = 0; i < result_segments_.size(); ++i)
+            n += result_segments_[i].size();
+        return n;
+    }
+    /* @brief: free the results on all cores */
     void free_results() {
-        for (size_t i = 0; i < results_.size(); ++i) {
-            this->key_free(results_[i].key_);
-            results_[i].reset();
+        // the results of map_group own their value arrays
+        if (at == atype_mapgroup || !this->bulk_free_keys()) {
+            this->parallel_for(results_.size(), free_results_range, this);
+            this->parallel_for(result_segments_.size(), free_segments_range,
+                               this, nresult());
         }
         results_.shallow_free();
+        shallow_free_subarray(result_segments_);
+        result_segments_.shallow_free();
     }
 
   protected:
     void set_final_result() {
-        rb_.transfer(0, &results_);
+        if (this->skip_merge_phase()) {
+            rb_.transfer_all(&result_segments_);
+        } else if (this->unordered_output_) {
+            // the merge phase grouped the keys: its output is one segment
+            result_segments_.resize(1);
+            result_segments_[0].init();
+            rb_.transfer(0, &result_segments_[0]);
+        } else {
+            rb_.transfer(0, &results_);
+        }
     }
     int internal_final_output_compare(const void *p1, const void *p2) {
         return final_output_compare((T *)p1, (T *)p2);
@@ -58,21 +86,32 @@ struct app_impl_base : public mapreduce_appbase {
     reduce_bucket_manager_base *get_reduce_bucket_manager() {
         return &rb_;
     }
+    void free_result_array(xarray<T> &a, size_t first, size_t last) {
+        const bool free_keys = !this->bulk_free_keys();
+        for (size_t i = first; i < last; ++i) {
+            if (free_keys)
+                this->key_free(a[i].key_);
+            a[i].reset();
+        }
+    }
+    static void free_results_range(void *arg, size_t first, size_t last) {
+        app_impl_base *app = (app_impl_base *)arg;
+        app->free_result_array(app->results_, first, last);
+    }
+    static void free_segments_range(void *arg, size_t first, size_t last) {
+        app_impl_base *app = (app_impl_base *)arg;
+        for (size_t i = first; i < last; ++i)
+            app->free_result_array(app->result_segments_[i], 0,
+                                   app->result_segments_[i].size());
+    }
     bool skip_reduce_or_group_phase() {
         if (at == atype_maponly)
             return true;
-#ifdef MAP_MERGE_REDUCE
-#if USE_PSRS
-        return true;
-#endif
-	assert(0 && "TODO: support merge sort in MAP_MERGE_REDUCE mode\n");
-#else
-        return false;
-#endif
+        return !this->dense_nkey() && this->strategy_.map_merge_reduce();
     }
 
     void verify_before_run() {
-        assert(!results_.size());
+        assert(!results_.size() && !result_segments_.size());
     }
     void reset() {
         rb_.reset();
@@ -86,8 +125,12 @@ struct map_reduce : public app_impl_base<keyval_t, atype_mapreduce> {
     void set_reduce_task(int nreduce_task) {
         nreduce_or_group_task_ = nreduce_task;
     }
-    /* @brief: user defined reduce function.
+    /* @brief: user defined reduce function. Emit the output with @e; the
+        version without an emitter is still supported.
         Should not be provided when using vm */
+    virtual void reduce_function(void *k, void **v, size_t length, emitter &e) {
+        reduce_function(k, v, length);
+    }
     virtual void reduce_function(void *k, void **v, size_t length) {
         assert(0);
     }
@@ -127,6 +170,14 @@ struct map_group : public app_impl_base<keyvals_len_t, atype_mapgroup> {
 
 struct map_only : public app_impl_base<keyval_t, atype_maponly> {
     virtual ~map_only() {}
+  protected:
+    void set_final_result() {
+        // the map output of each core is never merged
+        if (skip_merge_phase())
+            transfer_map_output(&result_segments_);
+        else
+            app_impl_base<keyval_t, atype_maponly>::set_final_result();
+    }
 };
 
 #endif
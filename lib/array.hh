@@ -17,10 +17,31 @@
 
 #include <algorithm>
 #include "bsearch.hh"
+#include "bench.hh"
+#include "memstat.hh"
+#include "hugepage.hh"
 
 template <typename T>
 struct xarray_iterator;
 
+/* @brief: the subsystem that growth of an xarray<T> is charged to */
+template <typename T>
+struct xarray_mem_subsys {
+    static int get() {
+        return mem_subsys_;
+    }
+};
+
+template <>
+struct xarray_mem_subsys<void *> {
+    static int get() {
+        return mem_values;
+    }
+};
+
+/* The elements are moved with memcpy and realloc and cleared with bzero,
+   as the pairs and arrays of Metis allow even where they are not trivially
+   copyable; the pointers are passed as void * to say so. */
 template <typename T>
 struct xarray {
     explicit xarray(size_t n) {
@@ -37,11 +58,11 @@ struct xarray {
         assert(p < n_ && !multiplex());
         // Don't use &a_[p] to get the address of the @p-th element!
         // T may overload the & operator!
-        memmove(a_ + p, a_ + (p + 1), sizeof(T) * (n_ - p - 1));
+        memmove((void *) (a_ + p), a_ + (p + 1), sizeof(T) * (n_ - p - 1));
         --n_;
     }
     void zero() {
-        bzero(a_, sizeof(T) * size());
+        bzero((void *) a_, sizeof(T) * size());
     }
     void assign(const xarray<T> &a) {
         a_ = a.a_;
@@ -99,6 +120,16 @@ struct xarray {
     iterator end() {
         return iterator(this, n_);
     }
+    /* @brief: prefetch the element that a lookup compares with first */
+    void prefetch_lookup() const {
+        if (n_)
+            ::prefetch(a_ + n_ / 2);
+    }
+    /* @brief: prefetch the slot of the next push_back */
+    void prefetch_append() const {
+        if (n_ < capacity_)
+            ::prefetch(a_ + n_);
+    }
     template <typename F>
     size_t lower_bound(const T *key, const F &cmp, bool *bfound) {
         *bfound = false;
@@ -109,7 +140,7 @@ struct xarray {
     void insert(size_t pos, const T *e) {
         make_room();
         if (pos < n_)
-            memmove(a_ + (pos + 1), a_ + pos, sizeof(T) * (n_ - pos));
+            memmove((void *) (a_ + (pos + 1)), a_ + pos, sizeof(T) * (n_ - pos));
         a_[pos] = *e;
         ++n_;
     }
@@ -162,7 +193,7 @@ struct xarray {
         capacity_ = 0;
     }
     void copy(T *dst, ssize_t off, size_t n) const {
-        memcpy(dst, &a_[off], n * sizeof(T));
+        memcpy((void *) dst, &a_[off], n * sizeof(T));
     }
     size_t transfer(xarray<T> *dst) {
         assert(dst->size() == 0);
@@ -181,7 +212,7 @@ struct xarray {
         if (!n)
             return;
         set_capacity(n_ + n);
-        memcpy(a_ + n_, x, n * sizeof(T));
+        memcpy((void *) (a_ + n_), x, n * sizeof(T));
         n_ += n;
     }
     template <typename F>
@@ -189,11 +220,14 @@ struct xarray {
         qsort(a_, size(), sizeof(T), cmp);
     }
     void set_capacity(size_t c) {
+        if (c > capacity_)
+            mem_account(xarray_mem_subsys<T>::get(), (c - capacity_) * sizeof(T));
         if (c) {
             if (!capacity_)
                 a_ = reinterpret_cast<T *>(malloc(c * sizeof(T)));
             else
-                a_ = reinterpret_cast<T *>(realloc(a_, c * sizeof(T)));
+                a_ = reinterpret_cast<T *>(realloc((void *) a_, c * sizeof(T)));
+            huge_page_advise(a_, c * sizeof(T));
         } else if (capacity_) {
             free(a_);
             a_ = NULL;
@@ -248,6 +282,129 @@ struct xarray_iterator {
     size_t i_;
 };
 
+/* @brief: An array that keeps up to N elements inline, and moves them to
+   the heap when it grows beyond. There is no pointer to the inline
+   elements, so the array can be moved with memcpy like an xarray, but
+   array() is only valid until the array is moved. Like xarray, a single
+   element can also be multiplexed into the array (see set_multiplex_value). */
+template <typename T, size_t N>
+struct small_xarray {
+    // value-initializing inline_ also clears a_
+    static_assert(sizeof(T) * N >= sizeof(T *), "inline_ must cover a_");
+    small_xarray() : capacity_(), n_(), inline_() {
+    }
+    ~small_xarray() {
+        clear();
+    }
+    void init() {
+        n_ = 0;
+        capacity_ = 0;
+    }
+    void clear() {
+        if (spilled())
+            free(a_);
+        init();
+    }
+    void shallow_free() {
+        clear();
+    }
+    void assign(const small_xarray<T, N> &a) {
+        memcpy(static_cast<void *>(this), &a, sizeof(a));
+    }
+    size_t size() const {
+        return n_;
+    }
+    void trim(size_t n) {
+        assert(n <= n_);
+        n_ = n;
+    }
+    T *array() {
+        return spilled() ? a_ : inline_;
+    }
+    T *at(size_t index) {
+        return &array()[index];
+    }
+    T &operator[](size_t index) {
+        return array()[index];
+    }
+    void push_back(const T &e) {
+        assert(!multiplex());
+        if (n_ == capacity())
+            grow(n_ + 1);
+        array()[n_++] = e;
+    }
+    void append(small_xarray<T, N> &src) {
+        append(src.array(), src.size());
+    }
+    void append(T *x, size_t n) {
+        assert(!multiplex());
+        if (!n)
+            return;
+        if (n_ + n > capacity())
+            grow(n_ + n);
+        memcpy((void *) (array() + n_), x, n * sizeof(T));
+        n_ += n;
+    }
+    /* @brief: return the elements in an array on the heap, which the caller
+       owns, and empty this one */
+    T *release() {
+        assert(!multiplex());
+        T *a = NULL;
+        if (spilled()) {
+            a = a_;
+        } else if (n_) {
+            a = safe_malloc<T>(n_);
+            mem_account(xarray_mem_subsys<T>::get(), n_ * sizeof(T));
+            memcpy((void *) a, inline_, n_ * sizeof(T));
+        }
+        init();
+        return a;
+    }
+    T multiplex_value() const {
+        if (size() == 0)
+            return T();
+        assert(multiplex());
+        return inline_[0];
+    }
+    void set_multiplex_value(const T &v) {
+        if (!multiplex())
+            assert(size() == 0);
+        inline_[0] = v;
+        n_ = 1;
+        capacity_ = multiplex_flag;
+    }
+    bool multiplex() const {
+        return capacity_ == multiplex_flag;
+    }
+  private:
+    enum { multiplex_flag = size_t(1) << 63 };
+    bool spilled() const {
+        return capacity_ && !multiplex();
+    }
+    size_t capacity() const {
+        return spilled() ? capacity_ : N;
+    }
+    void grow(size_t n) {
+        const size_t c = std::max(n, std::max(size_t(4), capacity()) * 2);
+        mem_account(xarray_mem_subsys<T>::get(), (c - (spilled() ? capacity_ : 0)) * sizeof(T));
+        if (spilled()) {
+            a_ = reinterpret_cast<T *>(realloc((void *) a_, c * sizeof(T)));
+        } else {
+            T *a = reinterpret_cast<T *>(malloc(c * sizeof(T)));
+            memcpy((void *) a, inline_, n_ * sizeof(T));
+            a_ = a;
+        }
+        huge_page_advise(a_, c * sizeof(T));
+        capacity_ = c;
+    }
+    size_t capacity_;  // 0 if the elements are inline
+    size_t n_;
+    union {
+        T *a_;
+        T inline_[N];
+    };
+};
+
 template <typename T>
 inline size_t sum_subarray(xarray<xarray<T> > &a) {
     size_t n = 0;
@@ -30,6 +30,7 @@
 #include <math.h>
 #include <sys/stat.h>
 #include <algorithm>
+#include <new>
 
 #define JOS_PAGESIZE    4096
 enum { debug_print = 0 };
@@ -53,6 +54,28 @@ inline T *safe_malloc(int n = 1) {
     return (T *)x;
 }
 
+/* @brief: @n default constructed T from a cache line boundary, so that
+   per-core elements of a type aligned to JOS_CLINE share no line. Free
+   them with delete_aligned_array. */
+template <typename T>
+inline T *new_aligned_array(size_t n) {
+    void *x = NULL;
+    const int r = posix_memalign(&x, JOS_CLINE, sizeof(T) * std::max(n, size_t(1)));
+    assert(r == 0);
+    (void) r;
+    T *a = (T *)x;
+    for (size_t i = 0; i < n; ++i)
+        new (&a[i]) T();
+    return a;
+}
+
+template <typename T>
+inline void delete_aligned_array(T *a, size_t n) {
+    for (size_t i = 0; a && i < n; ++i)
+        a[i].~T();
+    free(a);
+}
+
 inline uint64_t tv2us(const timeval &v) {
     return uint64_t(v.tv_sec) * 1000000 + v.tv_usec;
 }
@@ -120,33 +143,74 @@ inline uint64_t usec(void) {
     return uint64_t(tv.tv_sec) * 1000000 + tv.tv_usec;
 }
 
+inline uint64_t monotonic_ns(void) {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+/* @brief: true if the TSC ticks at a constant rate across frequency
+   changes and idle states (CPUID 0x80000007, EDX bit 8) */
+inline bool tsc_invariant(void) {
+    uint32_t a, b, c, d;
+    __asm __volatile("cpuid":"=a"(a), "=b"(b), "=c"(c), "=d"(d):"a"(0x80000000));
+    if (a < 0x80000007)
+        return false;
+    __asm __volatile("cpuid":"=a"(a), "=b"(b), "=c"(c), "=d"(d):"a"(0x80000007));
+    return d & (1 << 8);
+}
+
+struct tsc_calibration {
+    bool invariant_;
+    uint64_t hz_;  // TSC ticks per second
+};
+
+/* @brief: measure the TSC rate against CLOCK_MONOTONIC once */
+inline const tsc_calibration &tsc_calibrated(void) {
+    enum { calibrate_ns = 20000000 };
+    static const tsc_calibration c = [] {
+        tsc_calibration x;
+        x.invariant_ = tsc_invariant();
+        const uint64_t n0 = monotonic_ns();
+        const uint64_t t0 = read_tsc();
+        uint64_t n1;
+        while ((n1 = monotonic_ns()) - n0 < calibrate_ns)
+            nop_pause();
+        x.hz_ = uint64_t(double(read_tsc() - t0) * 1e9 / (n1 - n0));
+        return x;
+    }();
+    return c;
+}
+
 inline uint64_t get_cpu_freq(void) {
 #ifdef JOS_USER
     return 2000 * 1024 * 1024;
 #else
-    FILE *f = fopen("/proc/cpuinfo", "r");
-    assert(f != NULL);
-    float freqf = 0;
-    char *line = NULL;
-    size_t len = 0;
-    while (getline(&line, &len, f) != EOF &&
-           sscanf(line, "cpu MHz\t: %f", &freqf) != 1);
-    if (line)
-        free(line);
-    fclose(f);
-    return uint64_t(freqf * (1 << 20));
+    return tsc_calibrated().hz_;
 #endif
 }
 
 inline uint64_t cycle_to_ms(uint64_t x) {
-    return (x * 1000) / get_cpu_freq();
+    return uint64_t(double(x) * 1000 / get_cpu_freq());
+}
+
+/* A clock for measuring elapsed time: the TSC if it is invariant, and
+   CLOCK_MONOTONIC in nanoseconds otherwise. */
+inline uint64_t read_clock(void) {
+    return tsc_calibrated().invariant_ ? read_tsc() : monotonic_ns();
 }
 
-inline uint32_t get_core_count(void) {
-    int r = sysconf(_SC_NPROCESSORS_ONLN);
-    if (r < 0)
-	eprint("get_core_count: error: %s\n", strerror(errno));
-    return r;
+/* @brief: ticks of read_clock per second */
+inline uint64_t clock_freq(void) {
+    return tsc_calibrated().invariant_ ? get_cpu_freq() : 1000000000;
+}
+
+inline double clock_to_us(uint64_t x) {
+    return double(x) * 1000000 / clock_freq();
+}
+
+inline uint64_t clock_to_ms(uint64_t x) {
+    return uint64_t(double(x) * 1000 / clock_freq());
 }
 
 inline void lfence(void) {
@@ -159,6 +223,20 @@ inline int atomic_add32_ret(int *cnt) {
     return __c;
 }
 
+/* @brief: a test-and-test-and-set lock for short critical sections */
+struct spinlock {
+    volatile int v_;
+    spinlock() : v_() {}
+    void lock() {
+        while (__sync_lock_test_and_set(&v_, 1))
+            while (v_)
+                nop_pause();
+    }
+    void unlock() {
+        __sync_lock_release(&v_);
+    }
+};
+
 template <typename T>
 inline T prime_lower_bound(T x) {
     for (int q = 2; q < sqrt(double(x)); ++q)
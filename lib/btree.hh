@@ -16,6 +16,8 @@
 #define BTREE_HH_ 1
 
 #include "bsearch.hh"
+#include "bench.hh"
+#include "memstat.hh"
 #include <inttypes.h>
 #include <string.h>
 #include <stdlib.h>
@@ -60,6 +62,7 @@ struct btnode_leaf : public btnode_base<PARAM> {
     }
     inline self_type *split() {
         auto right = new self_type;
+        mem_account(mem_map_ds, sizeof(self_type));
         memcpy(right->e_, &e_[order + 1], sizeof(e_[0]) * (1 + order));
         right->nk_ = order + 1;
         nk_ = order + 1;
@@ -117,6 +120,7 @@ struct btnode_internal : public btnode_base<PARAM> {
 
     inline self_type *split() {
         auto nn = new self_type;
+        mem_account(mem_map_ds, sizeof(self_type));
         nn->nk_ = order;
         memcpy(nn->e_, &e_[order + 1], sizeof(e_[0]) * (order + 1));
         nk_ = order;
@@ -181,6 +185,12 @@ struct btree_type {
 
     inline size_t size() const;
 
+    /* @brief: prefetch the root, which every lookup visits first */
+    void prefetch_lookup() const {
+        if (root_)
+            ::prefetch(root_);
+    }
+
     template <typename C>
     inline uint64_t transfer(C *dst);
 
@@ -270,6 +280,7 @@ void btree_type<P>::insert_internal(const key_type &key, base_node_type *left, b
     auto parent = left->parent_;
     if (!parent) {
 	auto newroot = new internal_node_type;
+        mem_account(mem_map_ds, sizeof(internal_node_type));
 	newroot->nk_ = 1;
         newroot->assign(0, left, key, right);
 	root_ = newroot;
@@ -302,6 +313,7 @@ template <typename P>
 btnode_leaf<P> *btree_type<P>::get_leaf(const key_type &key) {
     if (!nlevel_) {
 	root_ = new leaf_node_type;
+        mem_account(mem_map_ds, sizeof(leaf_node_type));
 	nlevel_ = 1;
 	nk_ = 0;
 	return static_cast<leaf_node_type *>(root_);
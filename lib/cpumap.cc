@@ -13,14 +13,209 @@
  * binding.
  */
 #include "lib/cpumap.hh"
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <assert.h>
+#include <algorithm>
+#include <tuple>
 
-static int logical_to_physical_[JOS_NCPU];
+namespace {
+
+int logical_to_physical_[CPU_SETSIZE];
+int ncpu_;
+bool initialized_ = false;
+
+cpu_place places_[CPU_SETSIZE];  // the usable cpus, by cpu number
+int nusable_;
+int placement_ = placement_linear;
+
+bool read_line(const char *dir, const char *name, char *buf, size_t len) {
+    char path[PATH_MAX];
+    if (snprintf(path, sizeof(path), "%s/%s", dir, name) >= int(sizeof(path)))
+        return false;
+    FILE *f = fopen(path, "r");
+    if (!f)
+        return false;
+    const bool ok = fgets(buf, len, f) != NULL;
+    fclose(f);
+    return ok;
+}
+
+const char cgroup_root[] = "/sys/fs/cgroup";
+const char sysfs_cpu[] = "/sys/devices/system/cpu";
+
+/* @brief: the directory of the cgroup v2 of this process in @dir. A
+   path too long for @dir is no cgroup. */
+bool cgroup_dir(char *dir, size_t len) {
+    FILE *f = fopen("/proc/self/cgroup", "r");
+    if (!f)
+        return false;
+    char line[PATH_MAX];
+    bool found = false;
+    while (!found && fgets(line, sizeof(line), f))
+        if (!strncmp(line, "0::", 3)) {
+            line[strcspn(line, "\n")] = 0;
+            found = snprintf(dir, len, "%s%s", cgroup_root, line + 3) < int(len);
+            break;
+        }
+    fclose(f);
+    return found;
+}
+
+}
+
+void cpumap_parse_cpu_list(const char *s, cpu_set_t *set) {
+    CPU_ZERO(set);
+    while (*s) {
+        char *e;
+        long first = strtol(s, &e, 10), last = first;
+        if (e == s)
+            break;
+        if (*e == '-')
+            last = strtol(e + 1, &e, 10);
+        for (long c = first; c <= last && c < CPU_SETSIZE; ++c)
+            CPU_SET(c, set);
+        if (*e != ',')
+            break;
+        s = e + 1;
+    }
+}
+
+int cpumap_quota_cpus(char *dir, const char *root) {
+    int n = 0;
+    char buf[128];
+    while (strlen(dir) > strlen(root)) {
+        long long quota, period;
+        // "max <period>" if unlimited
+        if (read_line(dir, "cpu.max", buf, sizeof(buf)) &&
+            sscanf(buf, "%lld %lld", &quota, &period) == 2 && period > 0) {
+            const int c = std::max(1LL, (quota + period - 1) / period);
+            n = n ? std::min(n, c) : c;
+        }
+        *strrchr(dir, '/') = 0;
+    }
+    return n;
+}
+
+void cpumap_read_topology(cpu_place *places, int n, const char *sysfs) {
+    char dir[PATH_MAX], buf[64];
+    int package[CPU_SETSIZE], core[CPU_SETSIZE];
+    int nsocket = 0;
+    int socket_id[CPU_SETSIZE];
+    for (int i = 0; i < n; ++i) {
+        const bool found = snprintf(dir, sizeof(dir), "%s/cpu%d/topology",
+                                    sysfs, places[i].cpu_) < int(sizeof(dir));
+        package[i] = found &&
+            read_line(dir, "physical_package_id", buf, sizeof(buf)) ?
+            atoi(buf) : 0;
+        // a cpu without core_id must not match the core_id of another
+        core[i] = found && read_line(dir, "core_id", buf, sizeof(buf)) ?
+            atoi(buf) : -1 - places[i].cpu_;
+        places[i].socket_ = std::find(socket_id, socket_id + nsocket,
+                                       package[i]) - socket_id;
+        if (places[i].socket_ == nsocket)
+            socket_id[nsocket++] = package[i];
+        // the first cpu of a core has thread 0, and ranks the core after
+        // the cores of the socket seen before
+        places[i].thread_ = 0;
+        int ncore = 0;
+        bool seen = false;
+        for (int j = 0; j < i; ++j) {
+            if (package[j] != package[i])
+                continue;
+            if (core[j] == core[i]) {
+                places[i].thread_ = places[j].thread_ + 1;
+                places[i].core_ = places[j].core_;
+                seen = true;
+            } else if (!places[j].thread_) {
+                ++ncore;
+            }
+        }
+        if (!seen)
+            places[i].core_ = ncore;
+    }
+}
+
+void cpumap_order(cpu_place *places, int n, int policy) {
+    assert(policy >= 0 && policy < placement_npolicy);
+    auto key = [=](const cpu_place &x) {
+        switch (policy) {
+        case placement_scatter:
+            return std::make_tuple(x.thread_, x.core_, x.socket_, x.cpu_);
+        case placement_compact:
+            return std::make_tuple(x.socket_, x.core_, x.thread_, x.cpu_);
+        default:
+            return std::make_tuple(x.cpu_, 0, 0, 0);
+        }
+    };
+    std::sort(places, places + n, [&](const cpu_place &x, const cpu_place &y) {
+        return key(x) < key(y);
+    });
+}
 
 void cpumap_init() {
-    for (int i = 0; i < JOS_NCPU; ++i)
-	logical_to_physical_[i] = i;
+    if (initialized_)
+        return;
+    initialized_ = true;
+    // the cpus this process may run on, before any worker is pinned
+    cpu_set_t usable;
+    if (sched_getaffinity(0, sizeof(usable), &usable) != 0) {
+        CPU_ZERO(&usable);
+        for (long c = 0; c < sysconf(_SC_NPROCESSORS_ONLN) && c < CPU_SETSIZE; ++c)
+            CPU_SET(c, &usable);
+    }
+    char dir[PATH_MAX], buf[4096];
+    int quota = 0;
+    if (cgroup_dir(dir, sizeof(dir))) {
+        cpu_set_t effective;
+        if (read_line(dir, "cpuset.cpus.effective", buf, sizeof(buf))) {
+            cpumap_parse_cpu_list(buf, &effective);
+            CPU_AND(&effective, &effective, &usable);
+            if (CPU_COUNT(&effective))
+                usable = effective;
+        }
+        quota = cpumap_quota_cpus(dir, cgroup_root);
+    }
+    nusable_ = 0;
+    for (int c = 0; c < CPU_SETSIZE; ++c)
+        if (CPU_ISSET(c, &usable))
+            places_[nusable_++].cpu_ = c;
+    if (!nusable_)
+        places_[nusable_++].cpu_ = 0;
+    cpumap_read_topology(places_, nusable_, sysfs_cpu);
+    for (int i = 0; i < nusable_; ++i)
+        logical_to_physical_[i] = places_[i].cpu_;
+    ncpu_ = nusable_;
+    if (quota && quota < ncpu_)
+        ncpu_ = quota;
+}
+
+int cpumap_ncpu() {
+    cpumap_init();
+    return ncpu_;
 }
 
 int cpumap_physical_cpuid(int i) {
-    return logical_to_physical_[i];
+    return logical_to_physical_[i % ncpu_];
+}
+
+bool cpumap_set_placement(int policy) {
+    assert(policy >= 0 && policy < placement_npolicy);
+    cpumap_init();
+    if (policy == placement_)
+        return false;
+    placement_ = policy;
+    cpu_place p[CPU_SETSIZE];
+    std::copy(places_, places_ + nusable_, p);
+    cpumap_order(p, nusable_, policy);
+    bool changed = false;
+    for (int i = 0; i < nusable_; ++i) {
+        changed = changed || logical_to_physical_[i] != p[i].cpu_;
+        logical_to_physical_[i] = p[i].cpu_;
+    }
+    return changed;
 }
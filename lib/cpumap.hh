@@ -15,8 +15,59 @@
 #ifndef CPUMAP_HH_
 #define CPUMAP_HH_ 1
 
+#include <sched.h>
+
 enum { main_core = 0 };
+
+/* the order in which the workers take the usable cpus */
+enum {
+    placement_linear,   // by cpu number
+    placement_scatter,  // a cpu of each physical core, alternating sockets,
+                        // before the SMT siblings
+    placement_compact,  // the SMT siblings of a core together, and the
+                        // cores of a socket before the next socket
+    placement_npolicy,
+};
+
+/* @brief: find the cpus the process may use: those of its affinity mask
+   and of the cpuset of its cgroup v2, no more than the cpu.max quotas of
+   the cgroup allow. Logical core i runs on the i-th of them, by cpu
+   number until cpumap_set_placement orders them. Only the first call
+   looks, before the workers are pinned. */
 void cpumap_init();
+/* @brief: the number of usable cpus, which bounds the number of workers
+   and sizes the per-core arrays */
+int cpumap_ncpu();
 int cpumap_physical_cpuid(int i);
+/* @brief: order the usable cpus by @policy, using the topology in
+   /sys/devices/system/cpu. Only the first cpumap_ncpu() of them are used
+   under a cpu.max quota.
+   @return: whether the cpu of any logical core changed */
+bool cpumap_set_placement(int policy);
+
+/* The steps of cpumap_init and cpumap_set_placement, on the files and
+   arrays given, for micro/cpumap_unit. */
+
+/* @brief: where a usable cpu is: its socket, the rank of its core in
+   the socket, and its rank among the SMT siblings of the core */
+struct cpu_place {
+    int cpu_;
+    int socket_;
+    int core_;
+    int thread_;
+};
+
+/* @brief: the cpus of a list such as "0-3,8" in @set */
+void cpumap_parse_cpu_list(const char *s, cpu_set_t *set);
+/* @brief: the cpus that the cpu.max quotas of the cgroup @dir and of its
+   ancestors up to @root allow, rounded up. 0 if there is no quota.
+   @dir is truncated to @root. */
+int cpumap_quota_cpus(char *dir, const char *root);
+/* @brief: fill the places of the @n cpus of @places, by cpu number,
+   from the topology under @sysfs (/sys/devices/system/cpu). A cpu
+   without topology is a core of its own in socket 0. */
+void cpumap_read_topology(cpu_place *places, int n, const char *sysfs);
+/* @brief: sort the @n cpus of @places in the order of @policy */
+void cpumap_order(cpu_place *places, int n, int policy);
 
 #endif
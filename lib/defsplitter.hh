@@ -18,30 +18,55 @@
 #include <pthread.h>
 #include <algorithm>
 #include <ctype.h>
+#include "hugepage.hh"
 
+/* @brief: a private, writable mapping of a file, followed by a NUL. With
+   huge pages (see huge_page_mode), it is a huge_page_file instead, which
+   the workers of the next job read. */
 struct mmap_file {
-    mmap_file(const char *f) {
+    mmap_file(const char *f) : hf_(NULL) {
         assert((fd_ = open(f, O_RDONLY)) >= 0);
         struct stat fst;
         assert(fstat(fd_, &fst) == 0);
         size_ = fst.st_size;
-        d_ = (char *)mmap(0, size_ + 1, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd_, 0);
-        assert(d_);
+        if (huge_page_mode() != huge_pages_off) {
+            hf_ = new huge_page_file(fd_, size_);
+            d_ = hf_->data();
+            return;
+        }
+        // The page after the end of the file would fault if the size is a
+        // multiple of the page size, so reserve the memory anonymously and
+        // map the file over it.
+        mapped_ = size_ + 1;
+        d_ = (char *)mmap(0, mapped_, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        assert(d_ != MAP_FAILED);
+        if (size_)
+            assert(mmap(d_, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+                        fd_, 0) == d_);
     }
-    mmap_file() : fd_(-1) {}
+    mmap_file() : fd_(-1), hf_(NULL) {}
     virtual ~mmap_file() {
         if (fd_ >= 0) {
-            assert(munmap(d_, size_ + 1) == 0);
+            if (hf_)
+                delete hf_;
+            else
+                assert(munmap(d_, mapped_) == 0);
             assert(close(fd_) == 0);
         }
     }
+    /* @brief: byte @i, read now if the job has not read the file yet */
     char &operator[](off_t i) {
+        if (hf_)
+            hf_->read_chunk_of(i);
         return d_[i];
     }
     size_t size_;
     char *d_;
   private:
     int fd_;
+    size_t mapped_;
+    huge_page_file *hf_;
 };
 
 struct defsplitter {
@@ -54,12 +79,6 @@ struct defsplitter {
         size_ = mf_.size_;
         d_ = mf_.d_;
     }
-    int prefault() {
-        int sum = 0;
-        for (size_t i = 0; i < size_; i += 4096)
-            sum += d_[i];
-        return sum;
-    }
     bool split(split_t *ma, int ncore, const char *stop, size_t align = 0);
     void trim(size_t sz) {
         assert(sz <= size_);
@@ -95,7 +114,10 @@ bool defsplitter::split(split_t *ma, int ncores, const char *stop, size_t align)
     }
     pos_ += ma->length;
     for (; pos_ < size_ && stop && !strchr(stop, d_[pos_]); ++pos_, ++ma->length);
-        
+    // the split owns the delimiter that ends it (see split_word::next)
+    if (pos_ < size_ && stop)
+        ++pos_, ++ma->length;
+
     pthread_mutex_unlock(&mu_);
     return true;
 }
@@ -119,6 +141,26 @@ struct split_word {
 	k[klen] = 0;
         return index;
     }
+    /* @brief: return the next word in place, without copying it: the word
+       is upper cased if @upper, and the delimiter following it is replaced
+       with a NUL. The split must be writable, and must own the delimiter
+       ending it, as with defsplitter. */
+    char *next(size_t &klen, bool upper = true) {
+        char *d = (char *)ma_->data;
+        for (; pos_ < ma_->length && whitespace(d[pos_]); ++pos_)
+            ;
+        if (pos_ == ma_->length)
+            return NULL;
+        char *k = &d[pos_];
+        for (; pos_ < ma_->length && !whitespace(d[pos_]); ++pos_)
+            if (upper)
+                d[pos_] = toupper(d[pos_]);
+        klen = &d[pos_] - k;
+        // at the end of the split, this is the NUL after the input
+        if (d[pos_])
+            d[pos_] = 0;
+        return k;
+    }
   private:
     bool whitespace(char c) {
         return c == ' ' || c == '\n' || c == '\r' || c == '\0' || c == '\t';
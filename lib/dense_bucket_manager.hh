@@ -0,0 +1,130 @@
+/* Metis
+ * Yandong Mao, Robert Morris, Frans Kaashoek
+ * Copyright (c) 2012 Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, subject to the conditions listed
+ * in the Metis LICENSE file. These conditions include: you must preserve this
+ * copyright notice, and you cannot mention the copyright holders in
+ * advertising related to the Software without their permission.  The Software
+ * is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Metis LICENSE file; the license in that file is legally
+ * binding.
+ */
+#ifndef DENSE_BUCKET_MANAGER_HH_
+#define DENSE_BUCKET_MANAGER_HH_ 1
+
+#include "map_bucket_manager.hh"
+
+/* @brief: A map bucket manager for applications whose keys are dense
+   integers (see mapreduce_appbase::set_dense_keys). Each core accumulates
+   the values of key i in slot i of its own array, the same way as the map
+   data structures do, so no key is ever searched for. Reduce task j merges
+   the j-th contiguous range of keys of all cores. */
+struct dense_bucket_manager : public map_bucket_manager_base {
+    explicit dense_bucket_manager(size_t nkey) : nkey_(nkey), rows_(), cols_() {}
+    ~dense_bucket_manager() {
+        reset();
+    }
+    void global_init(size_t rows, size_t cols) {
+        slots_.resize(rows);
+        for (size_t i = 0; i < rows; ++i)
+            slots_[i] = NULL;
+        rows_ = rows;
+        cols_ = cols;
+    }
+    void per_worker_init(size_t row) {
+        keyvals_t *s = safe_malloc<keyvals_t>(nkey_);
+        mem_account(nkey_ * sizeof(keyvals_t));
+        for (size_t i = 0; i < nkey_; ++i)
+            s[i].init();
+        slots_[row] = s;
+    }
+    void reset() {
+        for (size_t i = 0; i < slots_.size(); ++i) {
+            if (!slots_[i])
+                continue;
+            for (size_t k = 0; k < nkey_; ++k)
+                slots_[i][k].reset();
+            free(slots_[i]);
+        }
+        slots_.shallow_free();
+        rows_ = 0;
+    }
+    void rehash(size_t, map_bucket_manager_base *) {
+        assert(0 && "dense keys are never sampled");
+    }
+    void drain(size_t, pair_sink, void *) {
+        assert(0 && "dense keys are never sampled");
+    }
+    bool emit(size_t row, void *key, void *val, size_t keylen, unsigned) {
+        const size_t k = static_appbase::dense_key(key, keylen);
+        assert(k < nkey_);
+        keyvals_t *p = &slots_[row][k];
+        const bool newkey = !p->size();
+        if (newkey)
+            p->key_ = static_appbase::key_copy(key, keylen);
+        p->map_value_insert(val);
+        return newkey;
+    }
+    static bool emit_static(map_bucket_manager_base *m, size_t row, void *key,
+                            void *val, size_t keylen, unsigned hash) {
+        return static_cast<dense_bucket_manager *>(m)->dense_bucket_manager::emit(
+            row, key, val, keylen, hash);
+    }
+    emitter::emit_type emit_function() {
+        return emit_static;
+    }
+    static void emit_batch_static(map_bucket_manager_base *m, size_t row,
+                                  emit_pair *ps, size_t n) {
+        for (size_t i = 0; i < n; ++i)
+            ps[i].newkey_ = emit_static(m, row, ps[i].key_, ps[i].val_,
+                                        ps[i].keylen_, ps[i].hash_);
+    }
+    emitter::emit_batch_type emit_batch_function() {
+        return emit_batch_static;
+    }
+    void prepare_merge(size_t) {
+        assert(0 && "dense keys are always reduced");
+    }
+    void do_reduce_task(size_t col) {
+        keyvals_t dst;
+        for (size_t k = col * nkey_ / cols_; k < (col + 1) * nkey_ / cols_; ++k) {
+            bool found = false;
+            for (size_t i = 0; i < rows_; ++i) {
+                keyvals_t *src = &slots_[i][k];
+                if (!src->size())
+                    continue;
+                if (!found)
+                    dst.key_ = src->key_;
+                else
+                    static_appbase::key_free(src->key_);
+                found = true;
+                src->key_ = NULL;
+                dst.map_value_move(src);
+            }
+            if (found)
+                static_appbase::internal_reduce_emit(dst);
+        }
+    }
+    size_t nrow() const {
+        return rows_;
+    }
+    size_t ncol() const {
+        return cols_;
+    }
+    void psrs_output_and_reduce(size_t, size_t) {
+        assert(0 && "dense keys are always reduced");
+    }
+    void mergesort_output_and_reduce(size_t, size_t) {
+        assert(0 && "dense keys are always reduced");
+    }
+  private:
+    size_t nkey_;
+    size_t rows_;
+    size_t cols_;
+    xarray<keyvals_t *> slots_;  // slots_[row][key]
+};
+
+#endif
@@ -41,38 +41,121 @@ inline void group_one_sorted(C &a, F &f, KF &kf) {
     }
 }
 
+template <typename C, typename F, typename KF>
+inline void group_sorted(C **nodes, int n, F &f, KF &kf);
+
+/* @brief: sort each of the @na collections in place, and group them by
+   merging, without copying them into one array first */
 template <typename C, typename F, typename PC, typename KF>
 inline void group_unsorted(C **a, int na, F &f, PC &pc, KF &kf) {
-    if (na == 1) {
-        a[0]->sort(pc);
+    for (int i = 0; i < na; i++)
+        a[i]->sort(pc);
+    if (na == 1)
         group_one_sorted(*a[0], f, kf);
+    else
+        group_sorted(a, na, f, kf);
+}
+
+/* @brief: an open addressing table of the keys of group_hashed, probed
+   linearly from the mixed hash of the pairs. An empty slot has no values. */
+struct hash_group_table {
+    hash_group_table() : t_(NULL), bits_(), nkey_() {
+        grow(min_bits);
     }
-    if (na <= 1)
-        return;
-    size_t np = 0;
-    for (int i = 0; i < na; i++)
-        np += a[i]->size();
-    C *one = new C;
-    one->set_capacity(np);
-    for (int i = 0; i < na; i++)
-        one->append(*a[i]);
-    one->sort(pc);
-    group_one_sorted(*one, f, kf);
-    delete one;
+    ~hash_group_table() {
+        free(t_);
+        mem_unaccount(nslot() * sizeof(keyvals_t));
+    }
+    /* @brief: the slot of the key of @p. @fresh is set if the key is new. */
+    keyvals_t *find(const keyval_t *p, bool *fresh) {
+        if (2 * (nkey_ + 1) > nslot())
+            grow(bits_ + 1);
+        size_t i = slot(p->hash);
+        while (t_[i].size() &&
+               static_appbase::key_compare(t_[i].key_, p->key_))
+            i = (i + 1) & (nslot() - 1);
+        *fresh = !t_[i].size();
+        if (*fresh) {
+            t_[i].key_ = p->key_;
+            t_[i].hash = p->hash;
+            ++nkey_;
+        }
+        return &t_[i];
+    }
+    size_t nslot() const {
+        return size_t(1) << bits_;
+    }
+    keyvals_t &operator[](size_t i) {
+        return t_[i];
+    }
+  private:
+    enum { min_bits = 10 };
+    size_t slot(unsigned h) const {
+        return (uint64_t(h) * 0x9e3779b97f4a7c15ULL) >> (64 - bits_);
+    }
+    void grow(int bits) {
+        keyvals_t *old = t_;
+        const size_t n = nslot();
+        bits_ = bits;
+        // all zero is an empty keyvals_t
+        t_ = (keyvals_t *)calloc(nslot(), sizeof(keyvals_t));
+        assert(t_);
+        mem_account(nslot() * sizeof(keyvals_t));
+        for (size_t i = 0; old && i < n; ++i) {
+            if (!old[i].size())
+                continue;
+            size_t j = slot(old[i].hash);
+            while (t_[j].size())
+                j = (j + 1) & (nslot() - 1);
+            // moved bitwise, as the other containers of keyvals_t do
+            memcpy((void *) &t_[j], &old[i], sizeof(keyvals_t));
+        }
+        if (old) {
+            free(old);
+            mem_unaccount(n * sizeof(keyvals_t));
+        }
+    }
+    keyvals_t *t_;
+    int bits_;
+    size_t nkey_;
+};
+
+/* @brief: group the pairs of the @na collections with a hash table
+   instead of sorting them, for output that need not be sorted. The keys
+   reach @f in no particular order. */
+template <typename C, typename F, typename KF>
+inline void group_hashed(C **a, int na, F &f, KF &kf) {
+    hash_group_table t;
+    for (int i = 0; i < na; ++i)
+        for (auto it = a[i]->begin(); it != a[i]->end(); ++it) {
+            bool fresh;
+            keyvals_t *kvs = t.find(&(*it), &fresh);
+            if (!fresh) {
+                kf(it->key_);
+                it->key_ = NULL;
+            }
+            kvs->map_value_move(&(*it));
+        }
+    for (size_t i = 0; i < t.nslot(); ++i)
+        if (t[i].size()) {
+            f(t[i]);
+            // frees the values left by the reduce function
+            t[i].reset();
+        }
 }
 
 template <typename C, typename F, typename KF>
 inline void group_sorted(C **nodes, int n, F &f, KF &kf) {
     if (!n)
         return;
-    typename C::iterator it[JOS_NCPU];
+    xarray<typename C::iterator> it(n);
     for (int i = 0; i < n; i++)
 	 it[i] = nodes[i]->begin();
-    int marks[JOS_NCPU];
+    xarray<int> marks(n);
     keyvals_t dst;
     while (1) {
 	int min_idx = -1;
-	bzero(marks, sizeof(marks));
+	marks.zero();
 	int m = 0;
 	// Find minimum key
 	for (int i = 0; i < n; ++i) {
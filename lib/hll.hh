@@ -0,0 +1,132 @@
+/* Metis
+ * Yandong Mao, Robert Morris, Frans Kaashoek
+ * Copyright (c) 2012 Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, subject to the conditions listed
+ * in the Metis LICENSE file. These conditions include: you must preserve this
+ * copyright notice, and you cannot mention the copyright holders in
+ * advertising related to the Software without their permission.  The Software
+ * is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Metis LICENSE file; the license in that file is legally
+ * binding.
+ */
+#ifndef HLL_HH_
+#define HLL_HH_ 1
+
+#include <inttypes.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+inline uint64_t fmix64(uint64_t k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+}
+
+/* @brief: HyperLogLog sketch of the number of distinct 64-bit hashes */
+struct hyperloglog {
+    enum { precision = 12, nreg = 1 << precision };
+
+    void init() {
+        memset(reg_, 0, sizeof(reg_));
+    }
+    void add(uint64_t h) {
+        const uint32_t i = h >> (64 - precision);
+        // the sentinel bit bounds the rank by 64 - precision + 1
+        const uint64_t w = (h << precision) | (uint64_t(1) << (precision - 1));
+        const uint8_t rank = __builtin_clzll(w) + 1;
+        if (rank > reg_[i])
+            reg_[i] = rank;
+    }
+    void merge(const hyperloglog &a) {
+        for (int i = 0; i < nreg; ++i)
+            if (a.reg_[i] > reg_[i])
+                reg_[i] = a.reg_[i];
+    }
+    double estimate() const {
+        double sum = 0;
+        int zeros = 0;
+        for (int i = 0; i < nreg; ++i) {
+            sum += ldexp(1.0, -reg_[i]);
+            zeros += !reg_[i];
+        }
+        const double m = nreg;
+        const double e = (0.7213 / (1 + 1.079 / m)) * m * m / sum;
+        // linear counting is more accurate for small cardinalities
+        if (e <= 2.5 * m && zeros)
+            return m * log(m / zeros);
+        return e;
+    }
+  private:
+    uint8_t reg_[nreg];
+};
+
+/* @brief: estimates the number of distinct keys of the whole input from
+   the pairs of the sampled map tasks. Every other sampled task (or, if only
+   one task is sampled, a pseudo-random half of its pairs) is also counted
+   separately, and the growth of distinct keys from half of the sample to
+   all of it gives the exponent of Heaps' law, D(n) = K * n^b, which is used
+   to extrapolate to the whole input. For Zipfian inputs b < 1, so this
+   predicts fewer keys than a linear extrapolation. */
+struct distinct_estimator {
+    void init() {
+        all_.init();
+        half_.init();
+        npair_ = nhalfpair_ = 0;
+        half_task_ = -1;
+    }
+    /* @brief: a sampled map task starts. @i is its index among the
+       @nsample sampled tasks */
+    void task_start(int i, int nsample) {
+        half_task_ = (nsample > 1) ? (i % 2 == 0) : -1;
+    }
+    /* @brief: a pair is emitted. @newkey tells whether the key is new to
+       this core, so that only the first occurrence goes into the sketch of
+       the whole sample. */
+    void onepair(bool newkey, unsigned hash) {
+        const uint64_t h = fmix64(hash);
+        if (newkey)
+            all_.add(h);
+        const bool half = (half_task_ >= 0) ? half_task_ : (fmix64(npair_) & 1);
+        ++npair_;
+        if (half) {
+            ++nhalfpair_;
+            half_.add(h);
+        }
+    }
+    /* @brief: estimate of the number of distinct keys of the input, given
+       the estimators of @n cores, and the total and sampled number of map
+       tasks. Returns 0 if there is no sample. */
+    static uint64_t predict(distinct_estimator *de, int n, uint64_t ntask,
+                            uint64_t nsample) {
+        distinct_estimator s;
+        s.init();
+        for (int i = 0; i < n; ++i) {
+            s.all_.merge(de[i].all_);
+            s.half_.merge(de[i].half_);
+            s.npair_ += de[i].npair_;
+            s.nhalfpair_ += de[i].nhalfpair_;
+        }
+        if (!s.nhalfpair_ || s.nhalfpair_ == s.npair_)
+            return 0;
+        const double d = s.all_.estimate();
+        const double dhalf = s.half_.estimate();
+        double b = log(d / dhalf) / log(double(s.npair_) / s.nhalfpair_);
+        b = std::max(0.0, std::min(1.0, b));
+        return uint64_t(d * pow(double(ntask) / nsample, b));
+    }
+  private:
+    hyperloglog all_;
+    hyperloglog half_;
+    uint64_t npair_;
+    uint64_t nhalfpair_;  // number of pairs in the half
+    int half_task_;  // whether the current task is in the half, or -1
+};
+
+#endif
@@ -0,0 +1,150 @@
+/* Metis
+ * Yandong Mao, Robert Morris, Frans Kaashoek
+ * Copyright (c) 2012 Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, subject to the conditions listed
+ * in the Metis LICENSE file. These conditions include: you must preserve this
+ * copyright notice, and you cannot mention the copyright holders in
+ * advertising related to the Software without their permission.  The Software
+ * is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Metis LICENSE file; the license in that file is legally
+ * binding.
+ */
+#include "hugepage.hh"
+#include "bench.hh"
+#include <sys/mman.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <assert.h>
+#include <algorithm>
+
+#ifndef MAP_HUGETLB
+#define MAP_HUGETLB 0x40000
+#endif
+
+namespace {
+const char *huge_page_mode_names[] = {"off", "thp", "hugetlb"};
+// the huge_page_files that exist, the latest first
+huge_page_file *files_ = NULL;
+
+int parse_huge_page_mode() {
+    const char *v = getenv("METIS_HUGE_PAGES");
+    if (!v)
+        return huge_pages_off;
+    for (int i = 0; i < huge_pages_nmode; ++i)
+        if (!strcmp(v, huge_page_mode_names[i]))
+            return i;
+    fprintf(stderr, "invalid METIS_HUGE_PAGES: %s\n", v);
+    exit(EXIT_FAILURE);
+}
+}
+
+int huge_page_mode() {
+    static const int mode = parse_huge_page_mode();
+    return mode;
+}
+
+void huge_page_advise_range(void *p, size_t len) {
+#ifdef MADV_HUGEPAGE
+    // only the huge pages inside the memory can be advised
+    uintptr_t s = round_up(uintptr_t(p), uintptr_t(huge_page_size));
+    uintptr_t e = round_down(uintptr_t(p) + len, uintptr_t(huge_page_size));
+    if (s < e)
+        madvise((void *)s, e - s, MADV_HUGEPAGE);
+#endif
+}
+
+void *huge_page_map(size_t len, size_t *mapped) {
+    const size_t n = round_up(len, size_t(huge_page_size));
+    void *p = MAP_FAILED;
+    if (huge_page_mode() == huge_pages_hugetlb)
+        p = mmap(0, n, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (p == MAP_FAILED) {
+        p = mmap(0, n, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        assert(p != MAP_FAILED);
+        if (huge_page_mode() != huge_pages_off)
+            huge_page_advise_range(p, n);
+    }
+    *mapped = n;
+    return p;
+}
+
+huge_page_file::huge_page_file(int fd, size_t size)
+    : fd_(fd), size_(size), complete_(size == 0), read_(NULL), next_(files_) {
+    d_ = (char *)huge_page_map(size_ + 1, &mapped_);
+    if (!complete_)
+        read_ = (char *)calloc(nchunk(), 1);
+    files_ = this;
+}
+
+huge_page_file::~huge_page_file() {
+    huge_page_file **p = &files_;
+    while (*p != this)
+        p = &(*p)->next_;
+    *p = next_;
+    free(read_);
+    assert(munmap(d_, mapped_) == 0);
+}
+
+void huge_page_file::read_chunk(size_t c) {
+    if (read_[c])
+        return;
+    const size_t end = std::min(size_, (c + 1) * huge_page_size);
+    for (size_t off = c * huge_page_size; off < end; ) {
+        const ssize_t r = pread(fd_, d_ + off, end - off, off);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r < 0) {
+            fprintf(stderr, "metis: cannot read the input: %s\n",
+                    strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+        // the file is shorter than when it was opened: the rest stays 0
+        if (r == 0)
+            break;
+        off += r;
+    }
+    read_[c] = 1;
+}
+
+size_t huge_page_pending_chunks() {
+    size_t n = 0;
+    for (huge_page_file *f = files_; f; f = f->next_)
+        if (!f->complete_)
+            n += f->nchunk();
+    return n;
+}
+
+void huge_page_read_pending(size_t first, size_t last) {
+    size_t base = 0;
+    for (huge_page_file *f = files_; f && base < last; f = f->next_) {
+        if (f->complete_)
+            continue;
+        const size_t n = f->nchunk();
+        for (size_t i = std::max(first, base); i < std::min(last, base + n); ++i)
+            f->read_chunk(i - base);
+        base += n;
+    }
+}
+
+void huge_page_pending_done() {
+    for (huge_page_file *f = files_; f; f = f->next_)
+        if (!f->complete_) {
+            f->complete_ = true;
+            free(f->read_);
+            f->read_ = NULL;
+        }
+}
+
+bool huge_page_file_read(const void *p) {
+    for (huge_page_file *f = files_; f; f = f->next_)
+        if (f->complete_ && p >= f->d_ && p < f->d_ + f->size_)
+            return true;
+    return false;
+}
@@ -0,0 +1,94 @@
+/* Metis
+ * Yandong Mao, Robert Morris, Frans Kaashoek
+ * Copyright (c) 2012 Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, subject to the conditions listed
+ * in the Metis LICENSE file. These conditions include: you must preserve this
+ * copyright notice, and you cannot mention the copyright holders in
+ * advertising related to the Software without their permission.  The Software
+ * is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Metis LICENSE file; the license in that file is legally
+ * binding.
+ */
+#ifndef HUGEPAGE_HH_
+#define HUGEPAGE_HH_ 1
+
+#include <stddef.h>
+
+/* How Metis backs its input and large arrays with huge pages */
+enum {
+    huge_pages_off,
+    huge_pages_thp,      // transparent huge pages, by madvise
+    huge_pages_hugetlb,  // the input from the hugetlb pool, arrays by thp
+    huge_pages_nmode,
+};
+
+enum { huge_page_size = 2 << 20 };
+
+/* @brief: the huge page mode of the process, from the METIS_HUGE_PAGES
+   environment variable: off (the default), thp or hugetlb */
+int huge_page_mode();
+
+void huge_page_advise_range(void *p, size_t len);
+
+/* @brief: ask for transparent huge pages for the heap memory at @p, if
+   it is large enough to hold one */
+inline void huge_page_advise(void *p, size_t len) {
+    if (len >= huge_page_size * 2 && huge_page_mode() != huge_pages_off)
+        huge_page_advise_range(p, len);
+}
+
+/* @brief: map at least @len bytes of private, zeroed anonymous memory,
+   backed by huge pages as huge_page_mode asks. hugetlb falls back to thp
+   if the pool is empty.
+   @return: the memory; *@mapped is the length to munmap */
+void *huge_page_map(size_t len, size_t *mapped);
+
+/* @brief: a file read into private memory mapped by huge_page_map, since
+   a file mapping can not use huge pages, followed by a NUL. The memory
+   is mapped at once, but the workers of the next job read the file into
+   it (see huge_page_read_pending), in chunks of huge_page_size, so that
+   the main thread does not populate all the pages alone. */
+struct huge_page_file {
+    huge_page_file(int fd, size_t size);
+    ~huge_page_file();
+    char *data() {
+        return d_;
+    }
+    /* @brief: read the chunk of byte @i now if the workers have not yet,
+       for the callers that look at the file before the job */
+    void read_chunk_of(size_t i) {
+        if (!complete_)
+            read_chunk(i / huge_page_size);
+    }
+  private:
+    friend size_t huge_page_pending_chunks();
+    friend void huge_page_read_pending(size_t first, size_t last);
+    friend void huge_page_pending_done();
+    friend bool huge_page_file_read(const void *p);
+    void read_chunk(size_t c);
+    size_t nchunk() const {
+        return (size_ + huge_page_size - 1) / huge_page_size;
+    }
+    int fd_;
+    size_t size_;
+    char *d_;
+    size_t mapped_;
+    bool complete_;  // all chunks are read
+    char *read_;     // whether each chunk is read, until complete_
+    huge_page_file *next_;
+};
+
+/* @brief: the number of chunks of the huge_page_files not read yet */
+size_t huge_page_pending_chunks();
+/* @brief: read the chunks [@first, @last) of those, numbered from 0 to
+   huge_page_pending_chunks(). Concurrent calls read disjoint ranges. */
+void huge_page_read_pending(size_t first, size_t last);
+/* @brief: mark the files read by huge_page_read_pending as complete */
+void huge_page_pending_done();
+/* @brief: whether @p is in a huge_page_file already read */
+bool huge_page_file_read(const void *p);
+
+#endif
@@ -1,26 +0,0 @@
-/* Metis
- * Yandong Mao, Robert Morris, Frans Kaashoek
- * Copyright (c) 2012 Massachusetts Institute of Technology
- *
- * Permission is hereby granted, free of charge, to any person obtaining a copy
- * of this software and associated documentation files (the "Software"), to
- * deal in the Software without restriction, subject to the conditions listed
- * in the Metis LICENSE file. These conditions include: you must preserve this
- * copyright notice, and you cannot mention the copyright holders in
- * advertising related to the Software without their permission.  The Software
- * is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
- * summary of the Metis LICENSE file; the license in that file is legally
- * binding.
- */
-#ifndef IBS_HH_
-#define IBS_HH_ 1
-
-#include <inttypes.h>
-
-void ibs_start(int cid);
-void ibs_stop(int cid);
-
-uint64_t ibs_read_count(int cid);
-uint64_t ibs_read_latency(int cid);
-
-#endif
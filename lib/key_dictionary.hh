@@ -0,0 +1,138 @@
+/* Metis
+ * Yandong Mao, Robert Morris, Frans Kaashoek
+ * Copyright (c) 2012 Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, subject to the conditions listed
+ * in the Metis LICENSE file. These conditions include: you must preserve this
+ * copyright notice, and you cannot mention the copyright holders in
+ * advertising related to the Software without their permission.  The Software
+ * is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Metis LICENSE file; the license in that file is legally
+ * binding.
+ */
+#ifndef KEY_DICTIONARY_HH_
+#define KEY_DICTIONARY_HH_ 1
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "bench.hh"
+#include "memstat.hh"
+
+/* @brief: A dictionary shared by all cores that interns keys, given as
+   bytes, into dense integer ids starting from 1, so that the map data
+   structures hold and compare ids instead of key copies. A key is looked
+   up without locking; inserting a new key locks its stripe of buckets,
+   and publishes the entry only after it is complete. */
+struct key_dictionary {
+    key_dictionary() : next_id_(1) {
+        heads_ = (entry *volatile *) calloc(nbucket, sizeof(entry *));
+        assert(heads_);
+        mem_account(mem_keys, nbucket * sizeof(entry *));
+        bzero((void *) chunks_, sizeof(chunks_));
+    }
+    ~key_dictionary() {
+        // free_keys may have freed some of the keys already
+        for (int id = 1; id < next_id_; ++id)
+            if (entry *e = get(id))
+                free(e);
+        for (size_t i = 0; i < max_chunk; ++i)
+            free(chunks_[i]);
+        free((void *) heads_);
+    }
+    /* @brief: the id of the @len bytes at @key, whose hash is @hash. If
+       @stable, @key stays valid and source returns it for the new key. */
+    uint32_t intern(void *key, size_t len, unsigned hash, bool stable) {
+        entry *volatile *head = &heads_[hash % nbucket];
+        if (entry *e = find(*head, key, len, hash))
+            return e->id_;
+        spinlock &l = locks_[hash % nlock];
+        l.lock();
+        entry *e = find(*head, key, len, hash);
+        if (!e) {
+            const size_t size = offsetof(entry, key_) + len + 1;
+            char *x = safe_malloc<char>(size);
+            mem_account(mem_keys, size);
+            char *k = x + offsetof(entry, key_);
+            memcpy(k, key, len);
+            k[len] = 0;
+            e = (entry *) x;
+            e->next_ = *head;
+            e->hash_ = hash;
+            e->len_ = len;
+            e->src_ = stable ? key : k;
+            e->id_ = atomic_add32_ret(&next_id_);
+            assert(size_t(e->id_) / chunk_size < max_chunk);
+            set(e->id_, e);
+            __sync_synchronize();
+            *head = e;
+        }
+        l.unlock();
+        return e->id_;
+    }
+    /* @brief: the bytes of the key of @id, followed by a NUL */
+    char *key(uint32_t id) const {
+        return get(id)->key_;
+    }
+    size_t length(uint32_t id) const {
+        return get(id)->len_;
+    }
+    /* @brief: the key of @id to copy for the output */
+    void *source(uint32_t id) const {
+        return get(id)->src_;
+    }
+    /* @brief: the ids are below id_end */
+    uint32_t id_end() const {
+        return next_id_;
+    }
+    /* @brief: free the keys of the ids in [@first, @last) ahead of the
+       destructor. Cores may free disjoint ranges in parallel. */
+    void free_keys(uint32_t first, uint32_t last) {
+        for (uint32_t id = std::max(first, uint32_t(1)); id < last; ++id)
+            if (entry *e = get(id)) {
+                free(e);
+                chunks_[id / chunk_size][id % chunk_size] = NULL;
+            }
+    }
+
+  private:
+    struct entry {
+        entry *next_;
+        unsigned hash_;
+        int id_;
+        size_t len_;
+        void *src_;
+        char key_[];
+    };
+    enum { nbucket = 1 << 17, nlock = 1 << 10 };
+    enum { chunk_size = 1 << 16, max_chunk = 1 << 15 };
+    static entry *find(entry *e, const void *key, size_t len, unsigned hash) {
+        for (; e; e = e->next_)
+            if (e->hash_ == hash && e->len_ == len && !memcmp(e->key_, key, len))
+                return e;
+        return NULL;
+    }
+    /* @brief: the entry of @id, or NULL if it is not set or was freed */
+    entry *get(uint32_t id) const {
+        entry **c = chunks_[id / chunk_size];
+        return c ? c[id % chunk_size] : NULL;
+    }
+    void set(uint32_t id, entry *e) {
+        entry **volatile *c = &chunks_[id / chunk_size];
+        if (!*c) {
+            entry **n = safe_malloc<entry *>(chunk_size);
+            mem_account(mem_keys, chunk_size * sizeof(entry *));
+            if (!__sync_bool_compare_and_swap(c, (entry **) NULL, n))
+                free(n);
+        }
+        (*c)[id % chunk_size] = e;
+    }
+    entry *volatile *heads_;
+    spinlock locks_[nlock];
+    int next_id_;
+    entry **volatile chunks_[max_chunk];  // entries by id
+};
+
+#endif
@@ -21,18 +21,26 @@
 #include "appbase.hh"
 
 struct map_bucket_manager_base {
+    typedef void (*pair_sink)(void *arg, keyvals_t *kvs);
     virtual ~map_bucket_manager_base() {}
     virtual void global_init(size_t rows, size_t cols) = 0;
     virtual void per_worker_init(size_t row) = 0;
     virtual void reset(void) = 0;
     virtual void rehash(size_t row, map_bucket_manager_base *backup) = 0;
+    /* @brief: pass each key of @row with its values to @f, which takes
+       them over, so that a manager of another type can rehash them */
+    virtual void drain(size_t row, pair_sink f, void *arg) = 0;
     virtual bool emit(size_t row, void *key, void *val, size_t keylen,
 	              unsigned hash) = 0;
+    /* @brief: the non-virtual emit function of the concrete type */
+    virtual emitter::emit_type emit_function() = 0;
+    virtual emitter::emit_batch_type emit_batch_function() = 0;
     virtual void prepare_merge(size_t row) = 0;
     virtual void do_reduce_task(size_t col) = 0;
     virtual size_t ncol() const = 0;
     virtual size_t nrow() const = 0;
     virtual void psrs_output_and_reduce(size_t ncpus, size_t lcpu) = 0;
+    virtual void mergesort_output_and_reduce(size_t ncpus, size_t lcpu) = 0;
 };
 
 template <typename DT, bool S>
@@ -49,12 +57,30 @@ struct group_analyzer<DT, true> {
 template <typename DT>
 struct group_analyzer<DT, false> {
     static void go(DT **a, size_t na) {
+        if (static_appbase::unordered_output()) {
+            group_hashed(a, na, static_appbase::internal_reduce_emit,
+                         static_appbase::key_free);
+            return;
+        }
         group_unsorted(a, na, static_appbase::internal_reduce_emit,
                        static_appbase::pair_comp<typename DT::element_type>,
                        static_appbase::key_free);
     }
 };
 
+inline void drain_pair(keyvals_t *p, map_bucket_manager_base::pair_sink f, void *arg) {
+    f(arg, p);
+    p->init();
+}
+
+inline void drain_pair(keyval_t *p, map_bucket_manager_base::pair_sink f, void *arg) {
+    keyvals_t kvs(p->key_, p->hash);
+    kvs.map_value_insert(p->val);
+    f(arg, &kvs);
+    kvs.init();
+    p->init();
+}
+
 template <typename DT, bool S>
 struct map_insert_analyzer {
 };
@@ -64,6 +90,9 @@ struct map_insert_analyzer<DT, true> {
     static bool copy_on_new(DT *dst, void *key, void *val, size_t keylen, unsigned hash) {
         return dst->map_insert_sorted_copy_on_new(key, val, keylen, hash);
     }
+    static void prefetch(const DT *dst) {
+        dst->prefetch_lookup();
+    }
     typedef typename DT::element_type T;
     static void insert_new_and_raw(DT *dst, T *t) {
         dst->map_insert_sorted_new_and_raw(t);
@@ -75,6 +104,9 @@ struct map_insert_analyzer<DT, false> {
     static bool copy_on_new(DT *dst, void *key, void *val, size_t keylen, unsigned hash) {
         return dst->map_append_copy(key, val, keylen, hash);
     }
+    static void prefetch(const DT *dst) {
+        dst->prefetch_append();
+    }
     typedef typename DT::element_type T;
     static void insert_new_and_raw(DT *dst, T *t) {
         dst->map_append_raw(t);
@@ -89,8 +121,28 @@ struct map_bucket_manager : public map_bucket_manager_base {
     void per_worker_init(size_t row);
     void reset(void);
     void rehash(size_t row, map_bucket_manager_base *backup);
+    void drain(size_t row, pair_sink f, void *arg);
     bool emit(size_t row, void *key, void *val, size_t keylen,
-	      unsigned hash);
+	      unsigned hash) {
+        DT *dst = mapdt_bucket(row, hash % cols_);
+        return map_insert_analyzer<DT, S>::copy_on_new(dst, key, val, keylen, hash);
+    }
+    static bool emit_static(map_bucket_manager_base *m, size_t row, void *key,
+                            void *val, size_t keylen, unsigned hash) {
+        return static_cast<map_bucket_manager *>(m)->map_bucket_manager::emit(
+            row, key, val, keylen, hash);
+    }
+    emitter::emit_type emit_function() {
+        return emit_static;
+    }
+    void emit_batch(size_t row, emit_pair *ps, size_t n);
+    static void emit_batch_static(map_bucket_manager_base *m, size_t row,
+                                  emit_pair *ps, size_t n) {
+        static_cast<map_bucket_manager *>(m)->emit_batch(row, ps, n);
+    }
+    emitter::emit_batch_type emit_batch_function() {
+        return emit_batch_static;
+    }
     void prepare_merge(size_t row);
     void do_reduce_task(size_t col);
     size_t nrow() const {
@@ -100,11 +152,18 @@ struct map_bucket_manager : public map_bucket_manager_base {
         return cols_;
     }
     void psrs_output_and_reduce(size_t ncpus, size_t lcpu);
+    void mergesort_output_and_reduce(size_t ncpus, size_t lcpu);
     typedef xarray<OPT> C;  // output bucket type
     C* get_output(size_t row) {
         assert(cols_ == 1);
         return &output_[row];
     }
+    /* @brief: append the map output of @row to @dst without merging or
+       copying it, one array per chunk of the append data structure */
+    void transfer_output_chunks(size_t row, xarray<C> *dst) {
+        assert(cols_ == 1);
+        mapdt_bucket(row, 0)->transfer_chunks(dst);
+    }
   private:
     DT *mapdt_bucket(size_t row, size_t col) {
         return mapdt_[row]->at(col);
@@ -113,6 +172,10 @@ struct map_bucket_manager : public map_bucket_manager_base {
         reset();
     }
     psrs<C> pi_;
+    // mergesort_output_and_reduce: the keys that partition the output
+    // among cores, and the candidates proposed by each core
+    xarray<const OPT *> splitters_;
+    xarray<const OPT *> samples_;
     size_t rows_;
     size_t cols_;
     xarray<xarray<DT> *> mapdt_;  // intermediate ds holding key/value pairs at map phase
@@ -123,8 +186,7 @@ template <bool S, typename DT, typename OPT>
 void map_bucket_manager<S, DT, OPT>::psrs_output_and_reduce(size_t ncpus, size_t lcpu) {
     // make sure we are using psrs so that after merge_reduced_buckets,
     // the final results is already in reduce bucket 0
-    const bool use_psrs = USE_PSRS;
-    assert(use_psrs);
+    assert(static_appbase::get_strategy().psrs_);
     C *out = NULL;
     if (lcpu == main_core)
         out = pi_.init(lcpu, sum_subarray(output_));
@@ -145,12 +207,77 @@ void map_bucket_manager<S, DT, OPT>::psrs_output_and_reduce(size_t ncpus, size_t
     shallow_free_subarray(output_, lcpu, ncpus);
 }
 
+/** @brief: Sort the output of the map phase with a parallel multiway
+    mergesort and reduce it. Each core sorts its own output, then core
+    @lcpu merges the pairs between the @lcpu-th and the (@lcpu + 1)-th
+    splitter of all outputs and reduces them. All pairs of a key fall into
+    the same partition, and the partitions are ordered, so the reduced
+    buckets 0..@ncpus - 1 hold the sorted output when all cores are done. */
+template <bool S, typename DT, typename OPT>
+void map_bucket_manager<S, DT, OPT>::mergesort_output_and_reduce(size_t ncpus, size_t lcpu) {
+    assert(rows_ == ncpus);
+    auto less = [](const OPT &a, const OPT &b) {
+        return static_appbase::pair_comp<OPT>(&a, &b) < 0;
+    };
+    C &mine = output_[lcpu];
+    if (!S)
+        mine.sort(static_appbase::pair_comp<OPT>);
+    // propose ncpus - 1 evenly spaced keys of the local output
+    for (size_t i = 0; i < ncpus - 1; ++i)
+        samples_[lcpu * (ncpus - 1) + i] =
+            mine.size() ? mine.at((i + 1) * mine.size() / ncpus) : NULL;
+    pi_.cpu_barrier(lcpu, ncpus);
+    if (lcpu == main_core) {
+        xarray<const OPT *> cand;
+        for (size_t i = 0; i < ncpus * (ncpus - 1); ++i)
+            if (samples_[i])
+                cand.push_back(samples_[i]);
+        std::sort(cand.array(), cand.array() + cand.size(), [&](const OPT *a, const OPT *b) {
+            return less(*a, *b);
+        });
+        // splitters_[0] and splitters_[ncpus] stand for the minimum and
+        // the maximum key. No candidate means that all outputs are empty.
+        for (size_t i = 1; i < ncpus; ++i)
+            splitters_[i] = cand.size() ? cand[i * cand.size() / ncpus] : NULL;
+    }
+    pi_.cpu_barrier(lcpu, ncpus);
+
+    // take pairs in (splitters_[lcpu], splitters_[lcpu + 1]] of each output
+    xarray<C> a(ncpus);
+    a.zero();
+    size_t np = 0;
+    for (size_t i = 0; i < ncpus; ++i) {
+        OPT *first = output_[i].array(), *last = first + output_[i].size();
+        OPT *s = (lcpu == 0 || !splitters_[lcpu]) ? first :
+            std::upper_bound(first, last, *splitters_[lcpu], less);
+        OPT *e = (lcpu == ncpus - 1 || !splitters_[lcpu + 1]) ? last :
+            std::upper_bound(first, last, *splitters_[lcpu + 1], less);
+        a[i].set_array(s, e - s);
+        np += e - s;
+    }
+    // grouping frees the duplicated keys, which may be splitters
+    pi_.cpu_barrier(lcpu, ncpus);
+    C myshare(np);
+    if (np)
+        mergesort_impl(a.array(), ncpus, 0, 1, static_appbase::pair_comp<OPT>, myshare);
+    for (size_t i = 0; i < ncpus; ++i)
+        a[i].init();  // a doesn't own the output
+    group_one_sorted(myshare, static_appbase::internal_reduce_emit,
+                     static_appbase::key_free);
+    myshare.shallow_free();
+    // barrier before freeing the output, which other cores may be reading
+    pi_.cpu_barrier(lcpu, ncpus);
+    mine.shallow_free();
+}
+
 template <bool S, typename DT, typename OPT>
 void map_bucket_manager<S, DT, OPT>::global_init(size_t rows, size_t cols) {
     mapdt_.resize(rows);
     output_.resize(rows * cols);
     for (size_t i = 0; i < output_.size(); ++i)
         output_[i].init();
+    splitters_.resize(rows + 1);
+    samples_.resize(rows * (rows - 1));
     rows_ = rows;
     cols_ = cols;
 }
@@ -176,6 +303,8 @@ void map_bucket_manager<S, DT, OPT>::reset() {
         free(mapdt_[i]);
     }
     mapdt_.shallow_free();
+    splitters_.shallow_free();
+    samples_.shallow_free();
 }
 
 template <bool S, typename DT, typename OPT>
@@ -194,10 +323,34 @@ void map_bucket_manager<S, DT, OPT>::rehash(size_t row, map_bucket_manager_base
 }
 
 template <bool S, typename DT, typename OPT>
-bool map_bucket_manager<S, DT, OPT>::emit(size_t row, void *k, void *v,
-                                          size_t keylen, unsigned hash) {
-    DT *dst = mapdt_bucket(row, hash % cols_);
-    return map_insert_analyzer<DT, S>::copy_on_new(dst, k, v, keylen, hash);
+void map_bucket_manager<S, DT, OPT>::drain(size_t row, pair_sink f, void *arg) {
+    for (size_t i = 0; i < cols_; ++i) {
+        DT *src = mapdt_bucket(row, i);
+        for (auto it = src->begin(); it != src->end(); ++it)
+            drain_pair(&(*it), f, arg);
+    }
+}
+
+template <bool S, typename DT, typename OPT>
+void map_bucket_manager<S, DT, OPT>::emit_batch(size_t row, emit_pair *ps, size_t n) {
+    enum { batch = 32 };
+    DT *dst[batch];
+    xarray<DT> *buckets = mapdt_[row];
+    for (size_t i = 0; i < n; i += batch) {
+        const size_t m = std::min(size_t(batch), n - i);
+        emit_pair *p = ps + i;
+        // prefetch the bucket headers, then the first node of each bucket,
+        // and insert once both have had time to arrive
+        for (size_t j = 0; j < m; ++j) {
+            dst[j] = buckets->at(p[j].hash_ % cols_);
+            ::prefetch(dst[j]);
+        }
+        for (size_t j = 0; j < m; ++j)
+            map_insert_analyzer<DT, S>::prefetch(dst[j]);
+        for (size_t j = 0; j < m; ++j)
+            p[j].newkey_ = map_insert_analyzer<DT, S>::copy_on_new(
+                dst[j], p[j].key_, p[j].val_, p[j].keylen_, p[j].hash_);
+    }
 }
 
 /** @brief: Copy the intermediate DS into an xarray<OPT> */
@@ -212,10 +365,10 @@ void map_bucket_manager<S, DT, OPT>::prepare_merge(size_t row) {
 
 template <bool S, typename DT, typename OPT>
 void map_bucket_manager<S, DT, OPT>::do_reduce_task(size_t col) {
-    DT *a[JOS_NCPU];
+    xarray<DT *> a(rows_);
     for (size_t i = 0; i < rows_; ++i)
         a[i] = mapdt_bucket(i, col);
-    group_analyzer<DT, S>::go(a, rows_);
+    group_analyzer<DT, S>::go(a.array(), rows_);
     for (size_t i = 0; i < rows_; ++i)
         a[i]->shallow_free();
 }
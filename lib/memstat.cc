@@ -0,0 +1,95 @@
+/* Metis
+ * Yandong Mao, Robert Morris, Frans Kaashoek
+ * Copyright (c) 2012 Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, subject to the conditions listed
+ * in the Metis LICENSE file. These conditions include: you must preserve this
+ * copyright notice, and you cannot mention the copyright holders in
+ * advertising related to the Software without their permission.  The Software
+ * is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Metis LICENSE file; the license in that file is legally
+ * binding.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include "memstat.hh"
+#include "cpumap.hh"
+#include "bench.hh"
+
+namespace {
+bool clear_refs_failed_ = false;
+// counts the allocations made before the worker pool exists
+mem_counter boot_counter_;
+int ncounter_ = 1;
+}
+
+mem_counter *mem_counters_ = &boot_counter_;
+JTLS int mem_core_ = 0;
+JTLS int mem_subsys_ = mem_other;
+
+void mem_init() {
+    if (mem_counters_ != &boot_counter_)
+        return;
+    // no pool, even one started again after mthread_finalize, has more
+    // cores than that
+    const int n = cpumap_ncpu();
+    mem_counter *c = new_aligned_array<mem_counter>(n);
+    c[main_core] = boot_counter_;
+    ncounter_ = n;
+    mem_counters_ = c;
+}
+
+void mem_set_core(int core) {
+    assert(core < ncounter_);
+    mem_core_ = core;
+}
+
+const char *mem_subsys_name(int subsys) {
+    static const char *names[] = {"MapDS", "Values", "Keys", "Reduce",
+                                  "Merge", "Other"};
+    return names[subsys];
+}
+
+void mem_sum(uint64_t *nalloc, uint64_t *bytes) {
+    memset(nalloc, 0, sizeof(uint64_t) * mem_nsubsys);
+    memset(bytes, 0, sizeof(uint64_t) * mem_nsubsys);
+    for (int i = 0; i < ncounter_; ++i)
+        for (int j = 0; j < mem_nsubsys; ++j) {
+            nalloc[j] += mem_counters_[i].nalloc_[j];
+            bytes[j] += mem_counters_[i].bytes_[j];
+        }
+}
+
+bool mem_reset_peak_rss() {
+    if (clear_refs_failed_)
+        return false;
+    // writing 5 to clear_refs resets VmHWM to the current RSS (Linux 4.0+)
+    int fd = open("/proc/self/clear_refs", O_WRONLY);
+    clear_refs_failed_ = (fd < 0 || write(fd, "5", 1) != 1);
+    if (fd >= 0)
+        close(fd);
+    return !clear_refs_failed_;
+}
+
+uint64_t mem_peak_rss() {
+    uint64_t kb = 0;
+    if (FILE *f = fopen("/proc/self/status", "r")) {
+        char line[256];
+        while (fgets(line, sizeof(line), f) &&
+               sscanf(line, "VmHWM: %" SCNu64 " kB", &kb) != 1)
+            ;
+        fclose(f);
+    }
+    if (!kb) {
+        rusage ru;
+        if (getrusage(RUSAGE_SELF, &ru) == 0)
+            kb = ru.ru_maxrss;
+    }
+    return kb * 1024;
+}
@@ -0,0 +1,95 @@
+/* Metis
+ * Yandong Mao, Robert Morris, Frans Kaashoek
+ * Copyright (c) 2012 Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, subject to the conditions listed
+ * in the Metis LICENSE file. These conditions include: you must preserve this
+ * copyright notice, and you cannot mention the copyright holders in
+ * advertising related to the Software without their permission.  The Software
+ * is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Metis LICENSE file; the license in that file is legally
+ * binding.
+ */
+#ifndef MEMSTAT_HH_
+#define MEMSTAT_HH_ 1
+
+#include <inttypes.h>
+#include <stddef.h>
+
+/* Subsystems that allocation counters are kept for. */
+enum mem_subsys_t {
+    mem_map_ds,    // map phase data structures: buckets, btree nodes
+    mem_values,    // value arrays of keyvals_t
+    mem_keys,      // keys copied by key_copy
+    mem_reduce,    // output buckets of the reduce phase
+    mem_merge,     // buffers of the merge phase
+    mem_other,
+    mem_nsubsys,
+};
+
+struct __attribute__ ((aligned(JOS_CLINE))) mem_counter {
+    uint64_t nalloc_[mem_nsubsys];
+    uint64_t bytes_[mem_nsubsys];
+};
+
+/* one per usable cpu once mem_init is called (see cpumap_ncpu) */
+extern mem_counter *mem_counters_;
+/* the core of the calling thread, and the subsystem its allocations are
+   charged to when the caller does not name one */
+extern JTLS int mem_core_;
+extern JTLS int mem_subsys_;
+
+/* @brief: charge @bytes newly allocated bytes to @subsys. Each core only
+   updates its own counters, so no atomic operation is needed. */
+inline void mem_account(int subsys, size_t bytes) {
+    mem_counter *c = &mem_counters_[mem_core_];
+    ++c->nalloc_[subsys];
+    c->bytes_[subsys] += bytes;
+}
+
+inline void mem_account(size_t bytes) {
+    mem_account(mem_subsys_, bytes);
+}
+
+/* @brief: take back @bytes of @subsys freed before the end of the job,
+   such as a table replaced by a larger one. The counters of the core may
+   wrap, but their sum over all cores does not. */
+inline void mem_unaccount(int subsys, size_t bytes) {
+    mem_counters_[mem_core_].bytes_[subsys] -= bytes;
+}
+
+inline void mem_unaccount(size_t bytes) {
+    mem_unaccount(mem_subsys_, bytes);
+}
+
+/* @brief: charge the allocations of the calling thread to @subsys
+   until the scope ends */
+struct mem_scope {
+    explicit mem_scope(int subsys) : old_(mem_subsys_) {
+        mem_subsys_ = subsys;
+    }
+    ~mem_scope() {
+        mem_subsys_ = old_;
+    }
+  private:
+    int old_;
+};
+
+/* @brief: give each usable cpu its own counters. Called when the first
+   worker pool starts; the allocations made before are charged to the
+   main core. */
+void mem_init();
+void mem_set_core(int core);
+const char *mem_subsys_name(int subsys);
+/* @brief: sum up the counters of all cores */
+void mem_sum(uint64_t *nalloc, uint64_t *bytes);
+
+/* @brief: reset the peak RSS of the process to the current RSS.
+   @return: false if the kernel does not support it */
+bool mem_reset_peak_rss();
+/* @brief: peak RSS in bytes since the last mem_reset_peak_rss */
+uint64_t mem_peak_rss();
+
+#endif
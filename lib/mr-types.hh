@@ -20,6 +20,7 @@
 #include <assert.h>
 #include <string.h>
 #include "array.hh"
+#include "segarray.hh"
 
 struct split_t {
     void *data;
@@ -105,7 +106,10 @@ struct keyvals_len_t {
 struct keyvals_len_arr_t: public xarray<keyvals_len_t> {
 };
 
-struct keyvals_t : public xarray<void *> {
+/* the number of values a key keeps before allocating an array */
+enum { keyvals_inline_values = 2 };
+
+struct keyvals_t : public small_xarray<void *, keyvals_inline_values> {
     void *key_;			/* put key at the same offset with keyval_t */
     unsigned hash;
     keyvals_t() {
@@ -124,15 +128,15 @@ struct keyvals_t : public xarray<void *> {
     }
     void init() {
         set(NULL, 0);
-        xarray<void *>::init();
+        small_xarray<void *, keyvals_inline_values>::init();
     }
     void reset() {
         set(0, 0);
-        xarray<void *>::clear();
+        small_xarray<void *, keyvals_inline_values>::clear();
     }
     void assign(const keyvals_t &a) {
         set(a.key_, a.hash);
-        xarray<void *>::assign(a);
+        small_xarray<void *, keyvals_inline_values>::assign(a);
     }
     void map_value_insert(void *v);
     void map_value_move(keyval_t *src);
@@ -145,11 +149,11 @@ struct keyvals_t : public xarray<void *> {
     }
 };
 
-struct keyval_arr_t : public xarray<keyval_t> {
+struct keyval_arr_t : public segarray<keyval_t> {
     bool map_append_copy(void *k, void *v, size_t keylen, unsigned hash);
     void map_append_raw(keyval_t *p);
     void transfer(xarray<keyvals_t> *dst);
-    using xarray<keyval_t>::transfer;
+    using segarray<keyval_t>::transfer;
 };
 
 struct keyvals_arr_t : public xarray<keyvals_t> {
@@ -0,0 +1,108 @@
+/* Metis
+ * Yandong Mao, Robert Morris, Frans Kaashoek
+ * Copyright (c) 2012 Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, subject to the conditions listed
+ * in the Metis LICENSE file. These conditions include: you must preserve this
+ * copyright notice, and you cannot mention the copyright holders in
+ * advertising related to the Software without their permission.  The Software
+ * is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Metis LICENSE file; the license in that file is legally
+ * binding.
+ */
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "perfctr.hh"
+
+namespace {
+struct event_desc {
+    uint32_t type_;
+    uint64_t config_;
+};
+
+const event_desc events[perf_ncounter] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB |
+                         (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                         (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+};
+
+int perf_event_open(const event_desc &e, int group) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = e.type_;
+    attr.config = e.config_;
+    attr.disabled = (group < 0);
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                       PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return syscall(__NR_perf_event_open, &attr, 0, -1, group, 0);
+}
+}
+
+perf_counters::perf_counters() : leader_(-1), nopen_(0) {
+    for (int i = 0; i < perf_ncounter; ++i)
+        fd_[i] = -1;
+}
+
+perf_counters::~perf_counters() {
+    close();
+}
+
+bool perf_counters::open() {
+    assert(!opened());
+    for (int i = 0; i < perf_ncounter; ++i) {
+        fd_[i] = perf_event_open(events[i], leader_);
+        if (fd_[i] < 0)
+            continue;
+        if (leader_ < 0)
+            leader_ = fd_[i];
+        order_[i] = nopen_++;
+    }
+    // the profile reports the times alone then, see prof_print
+    if (!opened())
+        return false;
+    ioctl(leader_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    return true;
+}
+
+void perf_counters::close() {
+    for (int i = 0; i < perf_ncounter; ++i)
+        if (fd_[i] >= 0) {
+            ::close(fd_[i]);
+            fd_[i] = -1;
+        }
+    leader_ = -1;
+    nopen_ = 0;
+}
+
+void perf_counters::read(uint64_t *v) const {
+    memset(v, 0, sizeof(*v) * perf_ncounter);
+    if (!opened())
+        return;
+    // layout of PERF_FORMAT_GROUP: nr, time_enabled, time_running, values[nr]
+    uint64_t buf[3 + perf_ncounter];
+    if (::read(leader_, buf, sizeof(buf)) < ssize_t(sizeof(uint64_t) * (3 + nopen_)))
+        return;
+    const double scale = buf[2] ? double(buf[1]) / buf[2] : 0;
+    for (int i = 0; i < perf_ncounter; ++i)
+        if (fd_[i] >= 0)
+            v[i] = uint64_t(buf[3 + order_[i]] * scale);
+}
+
+const char *perf_counters::name(int c) {
+    static const char *names[] = {"cycles", "instrs", "llc_miss",
+                                  "dtlb_miss", "br_miss"};
+    return names[c];
+}
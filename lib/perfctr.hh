@@ -0,0 +1,55 @@
+/* Metis
+ * Yandong Mao, Robert Morris, Frans Kaashoek
+ * Copyright (c) 2012 Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, subject to the conditions listed
+ * in the Metis LICENSE file. These conditions include: you must preserve this
+ * copyright notice, and you cannot mention the copyright holders in
+ * advertising related to the Software without their permission.  The Software
+ * is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Metis LICENSE file; the license in that file is legally
+ * binding.
+ */
+#ifndef PERFCTR_HH_
+#define PERFCTR_HH_ 1
+
+#include <inttypes.h>
+
+/* Hardware counters of the calling thread, read through perf_event_open(2).
+   Only user-level events are counted, so that the counters are available
+   with the default perf_event_paranoid setting. */
+
+enum perf_counter_t {
+    perf_cycles,
+    perf_instructions,
+    perf_llc_misses,
+    perf_dtlb_misses,
+    perf_branch_misses,
+    perf_ncounter,
+};
+
+struct perf_counters {
+    perf_counters();
+    ~perf_counters();
+    /* @brief: start counting the events of the calling thread. Counters
+       that the kernel or the hardware does not support read as zero.
+       @return: false if no counter could be opened */
+    bool open();
+    void close();
+    /* @brief: read the counters, scaled up if the kernel multiplexed them */
+    void read(uint64_t *v) const;
+    bool opened() const {
+        return leader_ >= 0;
+    }
+    static const char *name(int c);
+
+  private:
+    int leader_;
+    int fd_[perf_ncounter];
+    int nopen_;
+    int order_[perf_ncounter];  // position of each open counter in the group
+};
+
+#endif
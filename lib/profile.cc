@@ -16,41 +16,19 @@
 #include <iostream>
 #include "profile.hh"
 #include "bench.hh"
-#include "ibs.hh"
+#include "perfctr.hh"
 #include "mr-types.hh"
 #include "threadinfo.hh"
+#include "cpumap.hh"
 
-#ifdef PROFILE_ENABLED
-enum { profile_app = 1 };
-enum { profile_phases = 1 };
 enum { profile_kcmp = 0 };
-enum { profile_worker = 1 };
-/* Make sure the pmcs are programmed before enabling pmc */
-enum { pmc_enabled = 0 };
-
-enum { pmc0, pmc1, pmc2, pmc3, ibslat, ibscnt, tsc, app_tsc, app_kcmp,
-       app_pmc1, statcnt };
-
-#define stringify(name) #name
-
-static const char *cname[] = {
-    stringify(pmc0),
-    stringify(pmc1),
-    stringify(pmc2),
-    stringify(pmc3),
-    stringify(ibslat),
-    stringify(ibscnt),
-    stringify(tsc),
-    stringify(app_tsc),
-    stringify(app_kcmp),
-    stringify(app_pmc1),
-};
 
-static inline uint64_t __read_pmc(int ecx) {
-    if (pmc_enabled)
-	return read_pmc(ecx);
-    else
-	return 0;
+/* the first perf_ncounter stats are the hardware counters */
+enum { tsc = perf_ncounter, app_tsc, app_kcmp, statcnt };
+
+static const char *cname(int i) {
+    static const char *names[] = {"tsc", "app_tsc", "app_kcmp"};
+    return i < perf_ncounter ? perf_counters::name(i) : names[i - perf_ncounter];
 }
 
 struct __attribute__ ((aligned(JOS_CLINE))) percore_stat {
@@ -63,35 +41,31 @@ struct __attribute__ ((aligned(JOS_CLINE))) percore_stat {
     void leavekcmp() {
     }
     void enterapp() {
-        last_[app_tsc] = read_tsc();
-        last_[app_pmc1] = __read_pmc(1);
+        last_[app_tsc] = read_clock();
     }
     void leaveapp() {
-        v[cp_][app_tsc] += read_tsc() - last_[app_tsc];
-        v[cp_][app_pmc1] += __read_pmc(1) - last_[app_pmc1];
+        v[cp_][app_tsc] += read_clock() - last_[app_tsc];
     }
     void worker_start(int phase, int cid) {
         cp_ = phase;
         v[cp_][app_tsc] = 0;
         v[cp_][app_kcmp] = 0;
-        v[cp_][app_pmc1] = 0;
-        for (int i = 0; i < 4; ++i)
-            last_[i] = __read_pmc(i);
-
-        ibs_start(cid);
-        last_[ibscnt] = ibs_read_count(cid);
-        last_[ibslat] = ibs_read_latency(cid);
-        last_[tsc] = read_tsc();
+        // the worker of a core always runs on the same thread, so the
+        // counters opened by the first worker follow the later ones
+        if (!tried_) {
+            tried_ = true;
+            pc_.open();
+        }
+        pc_.read(last_);
+        last_[tsc] = read_clock();
     }
     void worker_end(int phase, int cid) {
         assert(phase == cp_);
-        for (int i = 0; i < 4; ++i)
-            v[cp_][i] = __read_pmc(i) - last_[i];
-
-        ibs_stop(cid);
-        v[cp_][ibslat] = ibs_read_latency(cid) - last_[ibslat];
-        v[cp_][ibscnt] = ibs_read_count(cid) - last_[ibscnt];
-        v[cp_][tsc] = read_tsc() - last_[tsc];
+        v[cp_][tsc] = read_clock() - last_[tsc];
+        uint64_t now[perf_ncounter];
+        pc_.read(now);
+        for (int i = 0; i < perf_ncounter; ++i)
+            v[cp_][i] = now[i] - last_[i];
     }
     void sum(uint64_t &app_tsc, uint64_t &kcmp) {
         app_tsc = 0;
@@ -101,48 +75,55 @@ struct __attribute__ ((aligned(JOS_CLINE))) percore_stat {
             kcmp += v[i][app_kcmp];
         }
     }
+    bool has_counters() const {
+        return pc_.opened();
+    }
 
   private:
     int cp_; // current phase
     uint64_t last_[statcnt];
+    bool tried_;
+    perf_counters pc_;
 };
 
-static percore_stat stats[JOS_NCPU];
+bool profile_enabled_ = false;
+static percore_stat *stats;  // one per usable cpu, once enabled
 
-void prof_enterkcmp() {
-    if (profile_app) {
-        threadinfo *ti = threadinfo::current();
-        stats[ti->cur_core_].enterkcmp();
-    }
+void prof_enable() {
+    if (profile_enabled_)
+        return;
+    stats = new_aligned_array<percore_stat>(cpumap_ncpu());
+    profile_enabled_ = true;
 }
 
-void prof_leavekcmp() {
-    if (profile_app) {
-        threadinfo *ti = threadinfo::current();
-        stats[ti->cur_core_].leavekcmp();
-    }
+void prof_record_enterkcmp() {
+    threadinfo *ti = threadinfo::current();
+    stats[ti->cur_core_].enterkcmp();
 }
 
-void prof_enterapp() {
-    if (profile_app) {
-	threadinfo *ti  = threadinfo::current();
-        stats[ti->cur_core_].enterapp();
-    }
+void prof_record_leavekcmp() {
+    threadinfo *ti = threadinfo::current();
+    stats[ti->cur_core_].leavekcmp();
 }
 
-void prof_leaveapp() {
-    if (profile_app) {
-        threadinfo *ti = threadinfo::current();
-        stats[ti->cur_core_].leaveapp();
-    }
+void prof_record_enterapp() {
+    threadinfo *ti  = threadinfo::current();
+    stats[ti->cur_core_].enterapp();
+}
+
+void prof_record_leaveapp() {
+    threadinfo *ti = threadinfo::current();
+    stats[ti->cur_core_].leaveapp();
 }
 
 void prof_worker_start(int phase, int cid) {
-    stats[cid].worker_start(phase, cid);
+    if (profile_enabled_)
+        stats[cid].worker_start(phase, cid);
 }
 
 void prof_worker_end(int phase, int cid) {
-    stats[cid].worker_end(phase, cid);
+    if (profile_enabled_)
+        stats[cid].worker_end(phase, cid);
 }
 
 static void prof_print_phase(int phase, int ncores, uint64_t scale) {
@@ -151,7 +132,7 @@ static void prof_print_phase(int phase, int ncores, uint64_t scale) {
     printf("core\t");
 #define WIDTH "10"
     for (int i = 0; i < statcnt; ++i)
-	printf("%" WIDTH "s", cname[i]);
+	printf("%" WIDTH "s", cname(i));
     printf("\n");
     for (int i = 0; i < ncores; ++i) {
 	printf("%d\t", i);
@@ -165,45 +146,50 @@ static void prof_print_phase(int phase, int ncores, uint64_t scale) {
     for (int i = 0; i < statcnt; ++i)
 	printf("%" WIDTH "ld", tots[i]);
     printf("\n");
-    printf("total[ibslat] / total[ibscnt] = %ld, total[pmc0] / total[pmc] = %4.2f\n",
-	   tots[ibslat] / (tots[ibscnt] + 1),
-	   (double) tots[pmc0] / (double) tots[pmc1]);
+    if (stats[main_core].has_counters())
+        printf("IPC = %4.2f, LLC misses per 1K instrs = %4.2f, "
+               "dTLB misses per 1K instrs = %4.2f\n",
+               double(tots[perf_instructions]) / (tots[perf_cycles] + 1),
+               1000.0 * tots[perf_llc_misses] / (tots[perf_instructions] + 1),
+               1000.0 * tots[perf_dtlb_misses] / (tots[perf_instructions] + 1));
+    else
+        printf("(hardware counters are not available)\n");
 }
 
 void prof_print(int ncores) {
+    if (!profile_enabled_)
+        return;
     if (profile_kcmp) {
 	uint64_t tt = 0;
 	uint64_t tkcmp = 0;
 	for (int i = 0; i < ncores; ++i) {
             uint64_t app_tsc, kcmp;
-            std::cout << i << "\t" << cycle_to_ms(app_tsc) << "ms, kcmp " 
+            std::cout << i << "\t" << clock_to_ms(app_tsc) << "ms, kcmp " 
                       << kcmp << std::endl;
 	    tt += app_tsc;
 	    tkcmp += kcmp;
 	}
-	std::cout << "Average time spent in application is " << cycle_to_ms(tt) 
+	std::cout << "Average time spent in application is " << clock_to_ms(tt) 
                   << ", total key_compare " << tkcmp << std::endl;
     }
-    if (profile_worker) {
-	uint64_t scale = 1000;
-	printf("MAP[scale=%ld]\n", scale);
-	prof_print_phase(MAP, ncores, scale);
-	printf("REDUCE[scale=%ld]\n", scale);
-	prof_print_phase(REDUCE, ncores, scale);
-	printf("MERGE[scale=%ld]\n", scale);
-	prof_print_phase(MERGE, ncores, scale);
-    }
+    uint64_t scale = 1000;
+    printf("MAP[scale=%ld]\n", scale);
+    prof_print_phase(MAP, ncores, scale);
+    printf("REDUCE[scale=%ld]\n", scale);
+    prof_print_phase(REDUCE, ncores, scale);
+    printf("MERGE[scale=%ld]\n", scale);
+    prof_print_phase(MERGE, ncores, scale);
 }
 
 void prof_phase_init() {
-    if (!profile_phases)
+    if (!profile_enabled_)
 	return;
     threadinfo *ti = threadinfo::current();
     assert(getrusage(RUSAGE_SELF, &stats[ti->cur_core_].ru_) == 0);
 }
 
 void prof_phase_end() {
-    if (!profile_phases)
+    if (!profile_enabled_)
 	return;
     rusage ru;
     assert(getrusage(RUSAGE_SELF, &ru) == 0);
@@ -213,5 +199,3 @@ void prof_phase_end() {
            tv2ms(ru.ru_utime) - tv2ms(st->ru_.ru_utime),
            tv2ms(ru.ru_stime) - tv2ms(st->ru_.ru_stime));
 }
-
-#endif
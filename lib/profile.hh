@@ -19,12 +19,43 @@
 #include <sys/time.h>
 #include <sys/resource.h>
 
+/* Per-core times and hardware counters of each phase. Profiling is off
+   unless enabled with prof_enable or by setting the METIS_PROFILE
+   environment variable before mapreduce_appbase::initialize; configure
+   --enable-profile turns it on by default. Where perf_event_open is not
+   permitted, only the times are reported. */
+
 #ifdef PROFILE_ENABLED
-void prof_enterapp();
-void prof_leaveapp();
+enum { profile_by_default = 1 };
+#else
+enum { profile_by_default = 0 };
+#endif
+
+extern bool profile_enabled_;
+
+void prof_enable();
+
+void prof_record_enterapp();
+void prof_record_leaveapp();
+void prof_record_enterkcmp();
+void prof_record_leavekcmp();
 
-void prof_enterkcmp();
-void prof_leavekcmp();
+inline void prof_enterapp() {
+    if (profile_enabled_)
+        prof_record_enterapp();
+}
+inline void prof_leaveapp() {
+    if (profile_enabled_)
+        prof_record_leaveapp();
+}
+inline void prof_enterkcmp() {
+    if (profile_enabled_)
+        prof_record_enterkcmp();
+}
+inline void prof_leavekcmp() {
+    if (profile_enabled_)
+        prof_record_leavekcmp();
+}
 
 void prof_worker_start(int phase, int cid);
 void prof_worker_end(int phase, int cid);
@@ -33,19 +64,4 @@ void prof_print(int ncores);
 void prof_phase_init();
 void prof_phase_end();
 
-#else
-
-#define prof_enterapp()
-#define prof_leaveapp()
-
-#define prof_enterkcmp()
-#define prof_leavekcmp()
-
-#define prof_phase_init()
-#define prof_phase_end()
-
-#define prof_worker_start(phase, cid)
-#define prof_worker_end(phase, cid)
-#define prof_print(ncpus)
-#endif
 #endif
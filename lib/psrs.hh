@@ -17,7 +17,6 @@
 
 #include <algorithm>
 #include "bench.hh"
-#include "bsearch.hh"
 #include "mergesort.hh"
 #include "cpumap.hh"
 
@@ -30,10 +29,18 @@ struct psrs {
         assert(me == main_core && output_ == NULL && status_ == STOP);
         return (output_ = new C(output_size));
     }
-    psrs() : lpairs_(JOS_NCPU), status_(STOP) {
-        bzero(ready_, sizeof(ready_));
+    /* @brief: for do_psrs on up to @ncpu cores */
+    explicit psrs(int ncpu = cpumap_ncpu())
+        : ncpu_(ncpu), lpairs_(ncpu_), status_(STOP) {
+        ready_ = new_aligned_array<ready_flag>(ncpu_);
+        pivots_.resize(ncpu_ * (ncpu_ - 1));
+        subsize_.resize(ncpu_ * (ncpu_ + 1));
+        partsize_.resize(ncpu_);
         deinit();
     }
+    ~psrs() {
+        delete_aligned_array(ready_, ncpu_);
+    }
   private:
     typedef typename C::element_type pair_type;
     /* @brief: Divide a[start..end] into subarrays using [pivots[fp], pivots[lp]],
@@ -49,9 +56,9 @@ struct psrs {
 
     void deinit() {
         output_ = NULL;
-	bzero(pivots_, sizeof(pivots_));
-	bzero(subsize_, sizeof(subsize_));
-	bzero(partsize_, sizeof(partsize_));
+	pivots_.zero();
+	subsize_.zero();
+	partsize_.zero();
         lpairs_.zero();
     }
     void check_inited() {
@@ -59,15 +66,18 @@ struct psrs {
     }
 
     enum { STOP, START };
-    union {
+    union ready_flag {
         char __pad[JOS_CLINE];
         volatile bool v;
-    } ready_[JOS_NCPU];
+    };
+    // sized for all usable cpus, so that any ncpus of do_psrs fits
+    const int ncpu_;
+    ready_flag *ready_;
 
-    pair_type pivots_[JOS_NCPU * (JOS_NCPU - 1)];
+    xarray<pair_type> pivots_;
     C *output_;
-    int subsize_[JOS_NCPU * (JOS_NCPU + 1)];
-    int partsize_[JOS_NCPU];
+    xarray<int> subsize_;
+    xarray<int> partsize_;
     xarray<C *> lpairs_;
     volatile int status_;
 };
@@ -103,9 +113,12 @@ void psrs<C>::divide(C &a, int start, int end, int *subsize, const pair_type *pi
 	             int fp, int lp, F &pcmp) {
     int mid = (fp + lp) / 2;
     const pair_type *pv = &pivots[mid];
-    // Find first element that is > pv
-    int pos = xsearch::upper_bound(pv, &a[start], end - start - 1, pcmp);
-    pos += start;
+    // Find first element that is > pv. a may hold equal keys, which must
+    // stay in the same sublist.
+    int pos = std::upper_bound(&a[start], &a[start] + end - start + 1, *pv,
+                               [&](const pair_type &x, const pair_type &y) {
+                                   return pcmp(&x, &y) < 0;
+                               }) - &a[0];
     subsize[mid] = pos;
     if (fp < mid) {
 	if (start < pos)
@@ -130,7 +143,8 @@ template <typename C> template <typename F>
 void psrs<C>::mergesort(xarray<C *> &per_core_pairs, int npairs, int *subsize,
                         int me, typename psrs<C>::pair_type *out,
 	                int ncore, F &pcmp) {
-    C a[JOS_NCPU];
+    xarray<C> a(ncore);
+    a.zero();
     for (int i = 0; i < ncore; ++i) {
         int s = subsize[i * (ncore + 1) + me];
         int e = subsize[i * (ncore + 1) + me + 1];
@@ -138,7 +152,7 @@ void psrs<C>::mergesort(xarray<C *> &per_core_pairs, int npairs, int *subsize,
     }
     C output;
     output.set_array(out, npairs);
-    mergesort_impl(a, ncore, 0, 1, pcmp, output);
+    mergesort_impl(a.array(), ncore, 0, 1, pcmp, output);
     // don't free the array! You guys don't own it!
     for (int i = 0; i < ncore; ++i)
         a[i].init();
@@ -177,6 +191,7 @@ C *psrs<C>::copy_elem(xarray<C> &a, int dst_start, int dst_end) {
  *          does not own the returned elements. */
 template <typename C> template <typename F>
 C *psrs<C>::do_psrs(xarray<C> &a, int ncpus, int me, F &pcmp) {
+    assert(ncpus <= ncpu_);
     if (me == main_core)
 	check_inited();
     cpu_barrier(me, ncpus);
@@ -215,7 +230,7 @@ C *psrs<C>::do_psrs(xarray<C> &a, int ncpus, int me, F &pcmp) {
 
     if (me == main_core) {
 	// sort p * (p - 1) pivots.
-	qsort(pivots_, ncpus * (ncpus - 1), sizeof(pair_type), pcmp);
+	qsort(pivots_.array(), ncpus * (ncpus - 1), sizeof(pair_type), pcmp);
 	// select (p - 1) pivots into pivots[1 : (p - 1)]
 	for (int i = 0; i < ncpus - 1; ++i)
             pivots_[i + 1] = pivots_[i * ncpus + ncpus / 2];
@@ -226,7 +241,7 @@ C *psrs<C>::do_psrs(xarray<C> &a, int ncpus, int me, F &pcmp) {
     subsize_[me * (ncpus + 1)] = 0;
     subsize_[me * (ncpus + 1) + ncpus] = localpairs->size();
     divide(*localpairs, 0, localpairs->size() - 1,
-           &subsize_[me * (ncpus + 1)], pivots_, 1, ncpus - 1, pcmp);
+           &subsize_[me * (ncpus + 1)], pivots_.array(), 1, ncpus - 1, pcmp);
     cpu_barrier(me, ncpus);
 
     // decides the size of the me-th sublist
@@ -243,7 +258,7 @@ C *psrs<C>::do_psrs(xarray<C> &a, int ncpus, int me, F &pcmp) {
     int output_offset = 0;
     for (int i = 0; i < me; ++i)
         output_offset += partsize_[i];
-    mergesort(lpairs_, partsize_[me], subsize_,
+    mergesort(lpairs_, partsize_[me], subsize_.array(),
               me, output_->at(output_offset), ncpus, pcmp);
     cpu_barrier(me, ncpus);
 
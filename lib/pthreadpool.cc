@@ -17,7 +17,9 @@
 #include "bench.hh"
 #include "cpumap.hh"
 #include "threadinfo.hh"
+#include "memstat.hh"
 #include <assert.h>
+#include <stdio.h>
 #include <string.h>
 
 struct  __attribute__ ((aligned(JOS_CLINE))) athread_type {
@@ -56,10 +58,24 @@ struct  __attribute__ ((aligned(JOS_CLINE))) athread_type {
 
 namespace {
 
-athread_type tp_[JOS_NCPU];
+athread_type *tp_;  // one per core of the pool
 bool tp_created_ = false;
 int ncore_ = 0;
 
+/* @brief: pin thread @tid to the cpu of @core. Metis still runs,
+   unpinned, where the cpu can not be chosen, e.g. in some containers. */
+void pin(pthread_t tid, int core) {
+    static int warned = 0;
+    const int cpu = cpumap_physical_cpuid(core);
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(cpu, &cpuset);
+    const int r = pthread_setaffinity_np(tid, sizeof(cpuset), &cpuset);
+    if (r != 0 && !__sync_lock_test_and_set(&warned, 1))
+        fprintf(stderr, "metis: cannot pin core %d to cpu %d: %s\n",
+                core, cpu, strerror(r));
+}
+
 void *mthread_exit(void *) {
     pthread_exit(NULL);
 }
@@ -67,7 +83,8 @@ void *mthread_exit(void *) {
 void *mthread_entry(void *args) {
     threadinfo *ti = threadinfo::current();
     ti->cur_core_ = ptr2int<int>(args);
-    assert(affinity_set(cpumap_physical_cpuid(ti->cur_core_)) == 0);
+    mem_set_core(ti->cur_core_);
+    pin(pthread_self(), ti->cur_core_);
     while (true)
         tp_[ti->cur_core_].run_next_task();
 }
@@ -97,11 +114,16 @@ void mthread_init(int ncore) {
         return;
     threadinfo *ti = threadinfo::current();
     cpumap_init();
+    // the per-core arrays have cpumap_ncpu() entries
+    assert(ncore > 0 && ncore <= cpumap_ncpu());
     ncore_ = ncore;
     ti->cur_core_ = main_core;
-    assert(affinity_set(cpumap_physical_cpuid(main_core)) == 0);
+    mem_init();
+    mem_set_core(main_core);
+    pin(pthread_self(), main_core);
     tp_created_ = true;
-    bzero(tp_, sizeof(tp_));
+    tp_ = new_aligned_array<athread_type>(ncore_);
+    bzero(tp_, sizeof(*tp_) * ncore_);
     for (int i = 0; i < ncore_; ++i)
 	if (i == main_core)
 	    tp_[i].tid_ = pthread_self();
@@ -109,6 +131,18 @@ void mthread_init(int ncore) {
 	    assert(pthread_create(&tp_[i].tid_, NULL, mthread_entry, int2ptr(i)) == 0);
 }
 
+void mthread_set_placement(int policy) {
+    if (!cpumap_set_placement(policy) || !tp_created_)
+        return;
+    // the workers are idle between jobs
+    for (int i = 0; i < ncore_; ++i)
+        pin(tp_[i].tid_, i);
+}
+
+int mthread_ncore(void) {
+    return tp_created_ ? ncore_ : 0;
+}
+
 void mthread_finalize(void) {
     if (!tp_created_)
         return;
@@ -118,5 +152,7 @@ void mthread_finalize(void) {
     for (int i = 0; i < ncore_; ++i)
 	if (i != main_core)
 	    pthread_join(tp_[i].tid_, NULL);
+    delete_aligned_array(tp_, ncore_);
+    tp_ = NULL;
     tp_created_ = false;
 }
@@ -63,8 +63,12 @@ struct reduce_bucket_manager : public reduce_bucket_manager_base {
         spread in rb[0..(ncpus - 1)]. */
     void merge_reduced_buckets(int ncpus, int lcpu) {
         C *out = NULL;
-        const int use_psrs = USE_PSRS;
-        if (!use_psrs) {
+        if (!static_appbase::get_strategy().psrs_) {
+            // the reduced buckets are sorted by key, which may not be
+            // the order of the final output
+            for (size_t i = lcpu; i < rb_.size(); i += ncpus)
+                if (!sorted(rb_[i]))
+                    rb_[i].sort(static_appbase::final_output_pair_comp);
             out = mergesort(rb_, ncpus, lcpu,
                             static_appbase::final_output_pair_comp);
             shallow_free_subarray(rb_, lcpu, ncpus);
@@ -94,7 +98,19 @@ struct reduce_bucket_manager : public reduce_bucket_manager_base {
         assert(dst->size() == 0);
         get(p)->swap(*dst);
     }
+    /** @brief: move all buckets, in the order of the reduce tasks, to the
+        empty @dst without merging them */
+    void transfer_all(xarray<C> *dst) {
+        assert(dst->size() == 0);
+        rb_.swap(*dst);
+    }
   private:
+    static bool sorted(C &a) {
+        for (size_t i = 1; i < a.size(); ++i)
+            if (static_appbase::final_output_pair_comp(a.at(i - 1), a.at(i)) > 0)
+                return false;
+        return true;
+    }
     int current_task() {
         return threadinfo::current()->cur_reduce_task_;
     }
@@ -0,0 +1,248 @@
+/* Metis
+ * Yandong Mao, Robert Morris, Frans Kaashoek
+ * Copyright (c) 2012 Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, subject to the conditions listed
+ * in the Metis LICENSE file. These conditions include: you must preserve this
+ * copyright notice, and you cannot mention the copyright holders in
+ * advertising related to the Software without their permission.  The Software
+ * is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Metis LICENSE file; the license in that file is legally
+ * binding.
+ */
+#ifndef SEGARRAY_HH_
+#define SEGARRAY_HH_ 1
+
+#include <algorithm>
+#include <iterator>
+#include "array.hh"
+
+template <typename T, int B>
+struct segarray_iterator;
+
+/* @brief: An array that grows by whole chunks of 2^B elements instead of
+   by realloc, so appending never copies or moves the elements, and the
+   memory in use never doubles. The first chunk grows like an xarray until
+   it is full, so that small arrays stay small. Element i lives in chunk
+   i >> B, and the array can be moved with memcpy like an xarray. */
+template <typename T, int B = 12>
+struct segarray {
+    enum { chunk_size = 1 << B, chunk_mask = chunk_size - 1 };
+    typedef segarray_iterator<T, B> iterator;
+    typedef T element_type;
+
+    segarray() {
+        init();
+    }
+    ~segarray() {
+        clear();
+    }
+    void init() {
+        chunks_.init();
+        n_ = 0;
+        cap0_ = 0;
+    }
+    void clear() {
+        for (size_t i = 0; i < chunks_.size(); ++i)
+            free(chunks_[i]);
+        chunks_.clear();
+        init();
+    }
+    void shallow_free() {
+        clear();
+    }
+    size_t size() const {
+        return n_;
+    }
+    T &operator[](size_t index) {
+        return chunks_[index >> B][index & chunk_mask];
+    }
+    T *at(size_t index) {
+        return &(*this)[index];
+    }
+    void push_back(const T &e) {
+        if (n_ == capacity())
+            grow();
+        (*this)[n_++] = e;
+    }
+    /* @brief: prefetch the slot of the next push_back */
+    void prefetch_append() const {
+        if (n_ < capacity())
+            ::prefetch(const_cast<segarray *>(this)->at(n_));
+    }
+    iterator begin() {
+        return iterator(this, 0);
+    }
+    iterator end() {
+        return iterator(this, n_);
+    }
+    /* @brief: sort with a qsort comparator. A single chunk is sorted in
+       place by qsort; otherwise the elements are sorted across chunks. */
+    template <typename F>
+    void sort(const F &cmp) {
+        if (chunks_.size() <= 1) {
+            if (n_)
+                qsort(chunks_[0], n_, sizeof(T), cmp);
+            return;
+        }
+        std::sort(begin(), end(), [&](const T &a, const T &b) {
+            return cmp(&a, &b) < 0;
+        });
+    }
+    /* @brief: move the elements into the empty xarray @dst. The chunks
+       are copied and freed one at a time, so the memory in use grows by
+       at most one chunk; a single chunk is handed over without copying. */
+    size_t transfer(xarray<T> *dst) {
+        assert(dst->size() == 0);
+        const size_t n = n_;
+        if (chunks_.size() == 1) {
+            dst->set_array(chunks_[0], n);
+            chunks_.clear();
+        } else if (n) {
+            dst->resize(n);
+            for (size_t i = 0; i < chunks_.size(); ++i) {
+                const size_t off = i << B;
+                // the elements are moved bitwise, as xarray does
+                memcpy((void *) dst->at(off), chunks_[i],
+                       std::min(size_t(chunk_size), n - off) * sizeof(T));
+                free(chunks_[i]);
+            }
+            chunks_.clear();
+        }
+        init();
+        return n;
+    }
+    /* @brief: append the elements to @dst as one xarray per chunk, in
+       order, handing the chunks over without copying them */
+    size_t transfer_chunks(xarray<xarray<T> > *dst) {
+        const size_t n = n_;
+        for (size_t i = 0; i < chunks_.size(); ++i) {
+            const size_t off = i << B;
+            dst->resize(dst->size() + 1);
+            dst->back().init();
+            dst->back().set_array(chunks_[i],
+                                  std::min(size_t(chunk_size), n - off));
+        }
+        chunks_.clear();
+        init();
+        return n;
+    }
+  private:
+    size_t capacity() const {
+        return chunks_.size() > 1 ? chunks_.size() << B : cap0_;
+    }
+    void grow() {
+        if (n_ < size_t(chunk_size)) {
+            // grow the first chunk
+            const size_t c = std::min(size_t(chunk_size), std::max(size_t(8), cap0_ * 2));
+            mem_account(xarray_mem_subsys<T>::get(), (c - cap0_) * sizeof(T));
+            if (!cap0_)
+                chunks_.push_back(safe_malloc<T>(c));
+            else
+                chunks_[0] = reinterpret_cast<T *>(
+                    realloc((void *) chunks_[0], c * sizeof(T)));
+            cap0_ = c;
+        } else {
+            mem_account(xarray_mem_subsys<T>::get(), chunk_size * sizeof(T));
+            chunks_.push_back(safe_malloc<T>(chunk_size));
+        }
+    }
+    xarray<T *> chunks_;
+    size_t n_;
+    size_t cap0_;  // capacity of the first chunk
+};
+
+/* @brief: A random access iterator over a segarray, which also has the
+   interface of xarray_iterator that mergesort_impl uses. */
+template <typename T, int B>
+struct segarray_iterator {
+    typedef std::random_access_iterator_tag iterator_category;
+    typedef T value_type;
+    typedef ptrdiff_t difference_type;
+    typedef T *pointer;
+    typedef T &reference;
+
+    segarray_iterator(segarray<T, B> *p, size_t i) : p_(p), i_(i) {}
+    segarray_iterator() : p_(NULL), i_(0) {}
+    bool operator==(const segarray_iterator &a) const {
+        assert(p_ == a.p_);
+        return i_ == a.i_;
+    }
+    bool operator!=(const segarray_iterator &a) const {
+        return !(*this == a);
+    }
+    bool operator<(const segarray_iterator &a) const {
+        return i_ < a.i_;
+    }
+    bool operator>(const segarray_iterator &a) const {
+        return i_ > a.i_;
+    }
+    bool operator<=(const segarray_iterator &a) const {
+        return i_ <= a.i_;
+    }
+    bool operator>=(const segarray_iterator &a) const {
+        return i_ >= a.i_;
+    }
+    segarray_iterator &operator++() {
+        ++i_;
+        return *this;
+    }
+    segarray_iterator operator++(int) {
+        segarray_iterator x(*this);
+        ++i_;
+        return x;
+    }
+    segarray_iterator &operator--() {
+        --i_;
+        return *this;
+    }
+    segarray_iterator operator--(int) {
+        segarray_iterator x(*this);
+        --i_;
+        return x;
+    }
+    segarray_iterator &operator+=(difference_type d) {
+        i_ += d;
+        return *this;
+    }
+    segarray_iterator &operator-=(difference_type d) {
+        i_ -= d;
+        return *this;
+    }
+    segarray_iterator operator+(difference_type d) const {
+        return segarray_iterator(p_, i_ + d);
+    }
+    segarray_iterator operator-(difference_type d) const {
+        return segarray_iterator(p_, i_ - d);
+    }
+    difference_type operator-(const segarray_iterator &a) const {
+        return difference_type(i_) - difference_type(a.i_);
+    }
+    T &operator[](difference_type d) const {
+        return (*p_)[i_ + d];
+    }
+    T &operator*() const {
+        return (*p_)[i_];
+    }
+    T *operator->() const {
+        return p_->at(i_);
+    }
+    T *current() const {
+        return p_->at(i_);
+    }
+    segarray_iterator parent_end() const {
+        return p_->end();
+    }
+  private:
+    segarray<T, B> *p_;
+    size_t i_;
+};
+
+template <typename T, int B>
+inline segarray_iterator<T, B> operator+(ptrdiff_t d, const segarray_iterator<T, B> &it) {
+    return it + d;
+}
+
+#endif
@@ -0,0 +1,136 @@
+/* Metis
+ * Yandong Mao, Robert Morris, Frans Kaashoek
+ * Copyright (c) 2012 Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, subject to the conditions listed
+ * in the Metis LICENSE file. These conditions include: you must preserve this
+ * copyright notice, and you cannot mention the copyright holders in
+ * advertising related to the Software without their permission.  The Software
+ * is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Metis LICENSE file; the license in that file is legally
+ * binding.
+ */
+#ifndef SHARED_BUCKET_MANAGER_HH_
+#define SHARED_BUCKET_MANAGER_HH_ 1
+
+#include "map_bucket_manager.hh"
+#include "bench.hh"
+
+/* @brief: A map bucket manager for jobs with few distinct keys. All cores
+   insert into one hash table of sorted arrays, so each key is kept once
+   instead of once per core, and the values of a key are accumulated as
+   they are emitted. Each bucket has its own spin lock; a bucket is locked
+   for the whole insert because the value modifier and key_copy are user
+   code. Reduce task j only reduces the keys of bucket j, and no pair of
+   the map phase is ever merged with another bucket. */
+struct shared_bucket_manager : public map_bucket_manager_base {
+    shared_bucket_manager() : rows_(), cols_(), buckets_(NULL) {}
+    ~shared_bucket_manager() {
+        reset();
+    }
+    void global_init(size_t rows, size_t cols) {
+        // padded buckets only avoid false sharing if the array is aligned
+        buckets_ = new_aligned_array<bucket>(cols);
+        mem_account(cols * sizeof(bucket));
+        rows_ = rows;
+        cols_ = cols;
+    }
+    void per_worker_init(size_t) {}
+    void reset() {
+        for (size_t i = 0; i < cols_; ++i) {
+            keyvals_arr_t &kvs = buckets_[i].kvs_;
+            for (size_t j = 0; j < kvs.size(); ++j)
+                kvs.at(j)->reset();
+            kvs.shallow_free();
+        }
+        delete_aligned_array(buckets_, cols_);
+        buckets_ = NULL;
+        rows_ = cols_ = 0;
+    }
+    void rehash(size_t row, map_bucket_manager_base *backup) {
+        backup->drain(row, insert_static, this);
+    }
+    void drain(size_t, pair_sink, void *) {
+        assert(0 && "the shared table is never sampled");
+    }
+    bool emit(size_t, void *key, void *val, size_t keylen, unsigned hash) {
+        bucket *b = &buckets_[hash % cols_];
+        b->lock_.lock();
+        const bool newkey = b->kvs_.map_insert_sorted_copy_on_new(key, val, keylen, hash);
+        b->lock_.unlock();
+        return newkey;
+    }
+    static bool emit_static(map_bucket_manager_base *m, size_t row, void *key,
+                            void *val, size_t keylen, unsigned hash) {
+        return static_cast<shared_bucket_manager *>(m)->shared_bucket_manager::emit(
+            row, key, val, keylen, hash);
+    }
+    emitter::emit_type emit_function() {
+        return emit_static;
+    }
+    static void emit_batch_static(map_bucket_manager_base *m, size_t row,
+                                  emit_pair *ps, size_t n) {
+        shared_bucket_manager *sm = static_cast<shared_bucket_manager *>(m);
+        for (size_t i = 0; i < n; ++i)
+            ::prefetch(&sm->buckets_[ps[i].hash_ % sm->cols_]);
+        for (size_t i = 0; i < n; ++i)
+            ps[i].newkey_ = sm->shared_bucket_manager::emit(
+                row, ps[i].key_, ps[i].val_, ps[i].keylen_, ps[i].hash_);
+    }
+    emitter::emit_batch_type emit_batch_function() {
+        return emit_batch_static;
+    }
+    void prepare_merge(size_t) {
+        assert(0 && "the shared table is always reduced");
+    }
+    void do_reduce_task(size_t col) {
+        keyvals_arr_t &kvs = buckets_[col].kvs_;
+        for (size_t i = 0; i < kvs.size(); ++i) {
+            static_appbase::internal_reduce_emit(*kvs.at(i));
+            kvs.at(i)->reset();
+        }
+        kvs.shallow_free();
+    }
+    size_t nrow() const {
+        return rows_;
+    }
+    size_t ncol() const {
+        return cols_;
+    }
+    void psrs_output_and_reduce(size_t, size_t) {
+        assert(0 && "the shared table is always reduced");
+    }
+    void mergesort_output_and_reduce(size_t, size_t) {
+        assert(0 && "the shared table is always reduced");
+    }
+  private:
+    struct __attribute__ ((aligned(JOS_CLINE))) bucket {
+        spinlock lock_;
+        keyvals_arr_t kvs_;
+    };
+    /* @brief: insert the pairs of a sampled key, which are moved into the
+       table */
+    static void insert_static(void *arg, keyvals_t *p) {
+        shared_bucket_manager *m = static_cast<shared_bucket_manager *>(arg);
+        bucket *b = &m->buckets_[p->hash % m->cols_];
+        b->lock_.lock();
+        bool found = false;
+        size_t pos = b->kvs_.lower_bound(p, static_appbase::pair_comp<keyvals_t>, &found);
+        if (found) {
+            static_appbase::key_free(p->key_);
+            p->key_ = NULL;
+            b->kvs_.at(pos)->map_value_move(p);
+        } else {
+            b->kvs_.insert(pos, p);
+            p->init();
+        }
+        b->lock_.unlock();
+    }
+    size_t rows_;
+    size_t cols_;
+    bucket *buckets_;
+};
+
+#endif
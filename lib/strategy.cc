@@ -0,0 +1,121 @@
+/* Metis
+ * Yandong Mao, Robert Morris, Frans Kaashoek
+ * Copyright (c) 2012 Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, subject to the conditions listed
+ * in the Metis LICENSE file. These conditions include: you must preserve this
+ * copyright notice, and you cannot mention the copyright holders in
+ * advertising related to the Software without their permission.  The Software
+ * is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Metis LICENSE file; the license in that file is legally
+ * binding.
+ */
+#include <string.h>
+#include <stdlib.h>
+#include "strategy.hh"
+#include "cpumap.hh"
+
+namespace {
+const char *mode_names[] = {"metis", "single_btree", "single_append-group_first",
+                            "single_append-merge_first"};
+const char *map_ds_names[] = {"append", "btree", "array"};
+const char *shared_table_names[] = {"off", "auto", "on"};
+const char *placement_names[] = {"linear", "scatter", "compact"};
+
+int lookup(const char *names[], int n, const std::string &v) {
+    for (int i = 0; i < n; ++i)
+        if (v == names[i])
+            return i;
+    return -1;
+}
+}
+
+strategy strategy::defaults() {
+    strategy s;
+    s.map_ds_ = DEFAULT_MAP_DS;
+    s.psrs_ = USE_PSRS;
+    s.dense_keys_ = true;
+    s.shared_table_ = shared_table_auto;
+    s.hot_keys_ = true;
+    s.intern_keys_ = false;
+    s.prefault_ = false;
+    s.placement_ = placement_linear;
+#if defined(SINGLE_APPEND_GROUP_FIRST)
+    s.mode_ = mode_single_append_group_first;
+#elif defined(MAP_MERGE_REDUCE)
+    s.mode_ = (DEFAULT_MAP_DS == index_btree) ? mode_single_btree
+                                              : mode_single_append_merge_first;
+#else
+    s.mode_ = mode_metis;
+#endif
+    return s;
+}
+
+bool strategy::parse(const char *spec) {
+    strategy s = *this;
+    std::string all(spec);
+    size_t start = 0;
+    while (start <= all.size()) {
+        size_t end = all.find(',', start);
+        if (end == std::string::npos)
+            end = all.size();
+        std::string opt = all.substr(start, end - start);
+        start = end + 1;
+        if (opt.empty())
+            continue;
+        size_t eq = opt.find('=');
+        if (eq == std::string::npos)
+            return false;
+        std::string k = opt.substr(0, eq), v = opt.substr(eq + 1);
+        if (k == "mode") {
+            if ((s.mode_ = lookup(mode_names, mode_nmode, v)) < 0)
+                return false;
+        } else if (k == "map-ds") {
+            if ((s.map_ds_ = lookup(map_ds_names, index_nmap_ds, v)) < 0)
+                return false;
+        } else if (k == "sort") {
+            if (v != "psrs" && v != "mergesort")
+                return false;
+            s.psrs_ = (v == "psrs");
+        } else if (k == "dense-keys") {
+            if (v != "on" && v != "off")
+                return false;
+            s.dense_keys_ = (v == "on");
+        } else if (k == "hot-keys") {
+            if (v != "on" && v != "off")
+                return false;
+            s.hot_keys_ = (v == "on");
+        } else if (k == "intern-keys") {
+            if (v != "on" && v != "off")
+                return false;
+            s.intern_keys_ = (v == "on");
+        } else if (k == "prefault") {
+            if (v != "on" && v != "off")
+                return false;
+            s.prefault_ = (v == "on");
+        } else if (k == "placement") {
+            if ((s.placement_ = lookup(placement_names, placement_npolicy, v)) < 0)
+                return false;
+        } else if (k == "shared-table") {
+            if ((s.shared_table_ = lookup(shared_table_names, shared_table_nmode, v)) < 0)
+                return false;
+        } else {
+            return false;
+        }
+    }
+    *this = s;
+    return true;
+}
+
+std::string strategy::to_string() const {
+    return std::string("mode=") + mode_names[mode_] + ",map-ds=" +
+        map_ds_names[map_ds()] + ",sort=" + (psrs_ ? "psrs" : "mergesort") +
+        ",dense-keys=" + (dense_keys_ ? "on" : "off") +
+        ",shared-table=" + shared_table_names[shared_table_] +
+        ",hot-keys=" + (hot_keys_ ? "on" : "off") +
+        ",intern-keys=" + (intern_keys_ ? "on" : "off") +
+        ",prefault=" + (prefault_ ? "on" : "off") +
+        ",placement=" + placement_names[placement_];
+}
@@ -0,0 +1,78 @@
+/* Metis
+ * Yandong Mao, Robert Morris, Frans Kaashoek
+ * Copyright (c) 2012 Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, subject to the conditions listed
+ * in the Metis LICENSE file. These conditions include: you must preserve this
+ * copyright notice, and you cannot mention the copyright holders in
+ * advertising related to the Software without their permission.  The Software
+ * is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Metis LICENSE file; the license in that file is legally
+ * binding.
+ */
+#ifndef STRATEGY_HH_
+#define STRATEGY_HH_ 1
+
+#include <string>
+
+/* data structures of the map phase. DEFAULT_MAP_DS names one of them. */
+enum { index_append, index_btree, index_array, index_nmap_ds };
+
+enum {
+    mode_metis,                        // map -> reduce -> merge
+    mode_single_btree,                 // grouped-map -> merge -> reduce
+    mode_single_append_group_first,    // (append-map -> group) -> (psrs-merge, and-reduce)
+    mode_single_append_merge_first,    // append-map -> (psrs-merge, and group-and-reduce)
+    mode_nmode,
+};
+
+/* whether the map phase uses one table shared by all cores */
+enum { shared_table_off, shared_table_auto, shared_table_on, shared_table_nmode };
+
+/* @brief: how Metis executes a job: the data structure of the map phase,
+   the sort algorithm and the pipeline. The configure options only choose
+   the default; see mapreduce_appbase::set_strategy. */
+struct strategy {
+    int mode_;
+    int map_ds_;    // ignored by the single_XXX modes, which imply one
+    bool psrs_;     // psrs or mergesort
+    bool dense_keys_;  // use the dense keys declared by the application
+    int shared_table_;  // auto: if sampling predicts few keys on many cores
+    bool hot_keys_;  // cache the hot keys of buffered_map_emit in each core
+    bool intern_keys_;  // intern the keys of buffered_map_emit into ids
+    bool prefault_;  // fault in the input on all cores before the job starts
+    int placement_;  // the order in which workers take the cpus (cpumap.hh)
+
+    /* @brief: the strategy chosen by configure */
+    static strategy defaults();
+    /* @brief: update the strategy from @spec, a comma separated list of
+       mode=..., map-ds=... and sort=..., using the values of configure,
+       dense-keys=on|off, shared-table=off|auto|on, hot-keys=on|off,
+       intern-keys=on|off, prefault=on|off and
+       placement=linear|scatter|compact.
+       @return: false if @spec is malformed; the strategy is unchanged then. */
+    bool parse(const char *spec);
+    std::string to_string() const;
+
+    bool map_merge_reduce() const {
+        return mode_ != mode_metis;
+    }
+    bool group_first() const {
+        return mode_ == mode_single_append_group_first;
+    }
+    int map_ds() const {
+        switch (mode_) {
+        case mode_single_btree:
+            return index_btree;
+        case mode_single_append_group_first:
+        case mode_single_append_merge_first:
+            return index_append;
+        default:
+            return map_ds_;
+        }
+    }
+};
+
+#endif
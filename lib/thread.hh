@@ -18,8 +18,15 @@
 #include <pthread.h>
 #include <inttypes.h>
 
+/* @brief: start a pool of @ncore workers. Only the first call starts
+   one; see mthread_ncore for the cores of the pool. */
 void mthread_init(int ncore);
+/* @brief: place the workers by @policy (see cpumap.hh), moving the
+   threads of a running pool to their new cpus */
+void mthread_set_placement(int policy);
 void mthread_finalize(void);
+/* @brief: the number of cores of the running pool, or 0 if there is none */
+int mthread_ncore(void);
 void mthread_create(pthread_t * tid, int lid,
 		    void *(*start_routine) (void *), void *arg);
 void mthread_join(pthread_t tid, int lid, void **exitcode);
@@ -0,0 +1,139 @@
+/* Metis
+ * Yandong Mao, Robert Morris, Frans Kaashoek
+ * Copyright (c) 2012 Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, subject to the conditions listed
+ * in the Metis LICENSE file. These conditions include: you must preserve this
+ * copyright notice, and you cannot mention the copyright holders in
+ * advertising related to the Software without their permission.  The Software
+ * is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Metis LICENSE file; the license in that file is legally
+ * binding.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "trace.hh"
+#include "threadinfo.hh"
+#include "mr-types.hh"
+#include "cpumap.hh"
+#include "bench.hh"
+
+bool trace_enabled_ = false;
+JTLS uint64_t trace_npair_ = 0;
+
+namespace {
+enum { ring_size = 1 << 16 };
+
+struct __attribute__ ((aligned(JOS_CLINE))) trace_ring {
+    trace_event *ev_;
+    uint64_t n_;  // number of events recorded since the last dump
+};
+
+trace_ring *rings_;  // one per usable cpu
+int nring_;
+FILE *out_ = NULL;
+uint64_t base_clock_;
+int nrun_;
+
+const char *phase_name(int phase) {
+    static const char *names[] = {"map", "reduce", "merge", "sample"};
+    return names[phase];
+}
+
+/* @brief: append a separator if this is not the first event of the file */
+void begin_event(bool &first) {
+    fprintf(out_, first ? "\n" : ",\n");
+    first = false;
+}
+
+void dump_event(const trace_event &e, int core, bool &first) {
+    const double ts = clock_to_us(e.start_ - base_clock_);
+    const double dur = clock_to_us(e.end_ - e.start_);
+    begin_event(first);
+    if (e.type_ == trace_phase) {
+        fprintf(out_, "{\"name\":\"%s\",\"cat\":\"phase\",\"ph\":\"X\","
+                "\"pid\":%d,\"tid\":0,\"ts\":%.3f,\"dur\":%.3f}",
+                phase_name(e.phase_), nrun_, ts, dur);
+        return;
+    }
+    const bool task = (e.type_ == trace_task);
+    fprintf(out_, "{\"name\":\"%s %s\",\"cat\":\"%s\",\"ph\":\"X\","
+            "\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,"
+            "\"args\":{\"%s\":%d,\"pairs\":%" PRIu64 "}}",
+            phase_name(e.phase_), task ? "task" : "worker", phase_name(e.phase_),
+            nrun_, core + 1, ts, dur, task ? "task" : "tasks", e.task_, e.npair_);
+}
+
+void dump_name(const char *what, int tid, const char *name, int id, bool &first) {
+    begin_event(first);
+    fprintf(out_, "{\"name\":\"%s\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,"
+            "\"args\":{\"name\":\"%s %d\"}}", what, nrun_, tid, name, id);
+}
+}
+
+bool trace_enable(const char *path) {
+    assert(!out_);
+    if (!(out_ = fopen(path, "w"))) {
+        fprintf(stderr, "trace_enable: can't open %s: %s\n", path, strerror(errno));
+        return false;
+    }
+    nring_ = cpumap_ncpu();
+    rings_ = new_aligned_array<trace_ring>(nring_);
+    for (int i = 0; i < nring_; ++i) {
+        rings_[i].ev_ = safe_malloc<trace_event>(ring_size);
+        rings_[i].n_ = 0;
+    }
+    fprintf(out_, "[]\n");
+    base_clock_ = read_clock();
+    nrun_ = 0;
+    trace_enabled_ = true;
+    return true;
+}
+
+void trace_record(int type, int phase, int task, uint64_t start, uint64_t npair) {
+    trace_ring &r = rings_[threadinfo::current()->cur_core_];
+    trace_event &e = r.ev_[r.n_++ % ring_size];
+    e.start_ = start;
+    e.end_ = read_clock();
+    e.npair_ = npair;
+    e.task_ = task;
+    e.phase_ = phase;
+    e.type_ = type;
+}
+
+void trace_dump(int ncore) {
+    if (!trace_enabled_)
+        return;
+    // overwrite the closing bracket so that the file is always valid JSON
+    fseek(out_, -2, SEEK_END);
+    bool first = (ftell(out_) == 1);
+    dump_name("process_name", 0, "sched_run", nrun_, first);
+    dump_name("thread_name", 0, "phases of run", nrun_, first);
+    for (int i = 0; i < ncore; ++i) {
+        trace_ring &r = rings_[i];
+        dump_name("thread_name", i + 1, "core", i, first);
+        if (r.n_ > ring_size)
+            fprintf(stderr, "trace: %" PRIu64 " events of core %d are lost\n",
+                    r.n_ - ring_size, i);
+        for (uint64_t j = (r.n_ > ring_size) ? r.n_ - ring_size : 0; j < r.n_; ++j)
+            dump_event(r.ev_[j % ring_size], i, first);
+        r.n_ = 0;
+    }
+    fprintf(out_, "]\n");
+    fflush(out_);
+    ++nrun_;
+}
+
+void trace_finalize() {
+    if (!trace_enabled_)
+        return;
+    trace_enabled_ = false;
+    fclose(out_);
+    out_ = NULL;
+    for (int i = 0; i < nring_; ++i)
+        free(rings_[i].ev_);
+    delete_aligned_array(rings_, nring_);
+    rings_ = NULL;
+}
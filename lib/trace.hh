@@ -0,0 +1,92 @@
+/* Metis
+ * Yandong Mao, Robert Morris, Frans Kaashoek
+ * Copyright (c) 2012 Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, subject to the conditions listed
+ * in the Metis LICENSE file. These conditions include: you must preserve this
+ * copyright notice, and you cannot mention the copyright holders in
+ * advertising related to the Software without their permission.  The Software
+ * is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Metis LICENSE file; the license in that file is legally
+ * binding.
+ */
+#ifndef TRACE_HH_
+#define TRACE_HH_ 1
+
+#include <inttypes.h>
+#include "bench.hh"
+#include "mr-types.hh"
+
+/* A timeline of the tasks executed by each core. Tracing is off unless
+   enabled with trace_enable or by setting the METIS_TRACE environment
+   variable to the output path before mapreduce_appbase::initialize. The
+   events are kept in a ring buffer per core, and at the end of each
+   sched_run they are appended to the output file in the Chrome trace
+   event format (load it in chrome://tracing or Perfetto). */
+
+enum trace_type_t {
+    trace_phase,   // from the start to the end of a phase, on the main thread
+    trace_worker,  // from the start to the end of a worker thread
+    trace_task,    // a single map or reduce task
+};
+
+/* phase of the events recorded by the sampling run */
+enum { trace_sample = MR_PHASES };
+
+struct trace_event {
+    uint64_t start_;
+    uint64_t end_;
+    uint64_t npair_;  // number of pairs emitted
+    int32_t task_;    // task id for a task; number of tasks for a worker
+    int16_t phase_;
+    int16_t type_;
+};
+
+extern bool trace_enabled_;
+/* number of pairs emitted by the calling thread */
+extern JTLS uint64_t trace_npair_;
+
+/* @brief: start writing the trace to @path.
+   @return: false if the file can not be created */
+bool trace_enable(const char *path);
+/* @brief: append the events of a sched_run to the trace file */
+void trace_dump(int ncore);
+void trace_finalize();
+void trace_record(int type, int phase, int task, uint64_t start, uint64_t npair);
+
+inline void trace_count_pair() {
+    ++trace_npair_;
+}
+
+/* @brief: record an event from the construction to the destruction
+   of the scope */
+struct trace_scope {
+    trace_scope(int type, int phase, int task = 0)
+        : on_(trace_enabled_) {
+        if (on_) {
+            type_ = type;
+            phase_ = phase;
+            task_ = task;
+            npair_ = trace_npair_;
+            start_ = read_clock();
+        }
+    }
+    ~trace_scope() {
+        if (on_)
+            trace_record(type_, phase_, task_, start_, trace_npair_ - npair_);
+    }
+    void set_task(int task) {
+        task_ = task;
+    }
+  private:
+    bool on_;
+    int type_;
+    int phase_;
+    int task_;
+    uint64_t npair_;
+    uint64_t start_;
+};
+
+#endif
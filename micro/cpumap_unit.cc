@@ -0,0 +1,158 @@
+/* Metis
+ * Yandong Mao, Robert Morris, Frans Kaashoek
+ * Copyright (c) 2012 Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, subject to the conditions listed
+ * in the Metis LICENSE file. These conditions include: you must preserve this
+ * copyright notice, and you cannot mention the copyright holders in
+ * advertising related to the Software without their permission.  The Software
+ * is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Metis LICENSE file; the license in that file is legally
+ * binding.
+ */
+#include "cpumap.hh"
+#include "test_util.hh"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <iostream>
+#include <string>
+
+static std::string cpus(const char *list) {
+    cpu_set_t set;
+    cpumap_parse_cpu_list(list, &set);
+    std::string s;
+    for (int c = 0; c < CPU_SETSIZE; ++c)
+        if (CPU_ISSET(c, &set))
+            s += (s.empty() ? "" : " ") + std::to_string(c);
+    return s;
+}
+
+static void test_parse_cpu_list() {
+    CHECK_EQ(std::string("0"), cpus("0\n"));
+    CHECK_EQ(std::string("0 1 2 3 8"), cpus("0-3,8\n"));
+    CHECK_EQ(std::string("2 4 5 6 10"), cpus("2,4-6,10"));
+    CHECK_EQ(std::string(""), cpus("\n"));
+    CHECK_EQ(std::string(""), cpus(""));
+    // cpus past CPU_SETSIZE are dropped
+    CHECK_EQ(std::string("1023"), cpus("1023-5000"));
+}
+
+static void make_dir(const std::string &d) {
+    assert(mkdir(d.c_str(), 0700) == 0);
+}
+
+static void write_file(const std::string &path, const char *s) {
+    FILE *f = fopen(path.c_str(), "w");
+    assert(f);
+    fputs(s, f);
+    fclose(f);
+}
+
+static int quota(const std::string &root, const std::string &dir) {
+    char d[PATH_MAX];
+    snprintf(d, sizeof(d), "%s", dir.c_str());
+    return cpumap_quota_cpus(d, root.c_str());
+}
+
+static void test_quota(const std::string &tmp) {
+    const std::string root = tmp + "/cgroup", a = root + "/a", b = a + "/b";
+    make_dir(root);
+    make_dir(a);
+    make_dir(b);
+    // the root's own cpu.max is not read
+    write_file(root + "/cpu.max", "100000 100000\n");
+    CHECK_EQ(0, quota(root, b));
+    write_file(b + "/cpu.max", "max 100000\n");
+    CHECK_EQ(0, quota(root, b));
+    // rounded up
+    write_file(b + "/cpu.max", "250000 100000\n");
+    CHECK_EQ(3, quota(root, b));
+    // at least one cpu
+    write_file(b + "/cpu.max", "1000 100000\n");
+    CHECK_EQ(1, quota(root, b));
+    // the smallest quota of the cgroup and its ancestors
+    write_file(b + "/cpu.max", "800000 100000\n");
+    write_file(a + "/cpu.max", "400000 100000\n");
+    CHECK_EQ(4, quota(root, b));
+    CHECK_EQ(4, quota(root, a));
+    write_file(b + "/cpu.max", "200000 100000\n");
+    CHECK_EQ(2, quota(root, b));
+    write_file(b + "/cpu.max", "garbage\n");
+    CHECK_EQ(4, quota(root, b));
+}
+
+/* @brief: 2 sockets of 2 cores of 2 SMT threads, numbered as on most
+   Intel machines: cpu i is in socket i % 2, core i / 2 % 2, thread i / 4.
+   The socket and core ids are not dense. cpu 8 has no topology, and its
+   number is the core_id of other cpus. */
+static void make_topology(const std::string &sysfs) {
+    make_dir(sysfs);
+    for (int i = 0; i < 9; ++i) {
+        const std::string cpu = sysfs + "/cpu" + std::to_string(i);
+        make_dir(cpu);
+        if (i == 8)
+            continue;
+        make_dir(cpu + "/topology");
+        write_file(cpu + "/topology/physical_package_id",
+                   (std::to_string(i % 2 * 3) + "\n").c_str());
+        write_file(cpu + "/topology/core_id",
+                   (std::to_string(i / 2 % 2 * 8) + "\n").c_str());
+    }
+}
+
+static std::string order(const std::string &sysfs, int policy) {
+    cpu_place p[9];
+    for (int i = 0; i < 9; ++i)
+        p[i].cpu_ = i;
+    cpumap_read_topology(p, 9, sysfs.c_str());
+    cpumap_order(p, 9, policy);
+    std::string s;
+    for (int i = 0; i < 9; ++i)
+        s += (s.empty() ? "" : " ") + std::to_string(p[i].cpu_);
+    return s;
+}
+
+static void test_placement(const std::string &tmp) {
+    const std::string sysfs = tmp + "/cpu";
+    make_topology(sysfs);
+    cpu_place p[9];
+    for (int i = 0; i < 9; ++i)
+        p[i].cpu_ = i;
+    cpumap_read_topology(p, 9, sysfs.c_str());
+    for (int i = 0; i < 8; ++i) {
+        CHECK_EQ(i % 2, p[i].socket_);
+        CHECK_EQ(i / 2 % 2, p[i].core_);
+        CHECK_EQ(i / 4, p[i].thread_);
+    }
+    // cpu 8 is the third core of socket 0
+    CHECK_EQ(0, p[8].socket_);
+    CHECK_EQ(2, p[8].core_);
+    CHECK_EQ(0, p[8].thread_);
+
+    CHECK_EQ(std::string("0 1 2 3 4 5 6 7 8"), order(sysfs, placement_linear));
+    // one cpu of each core, alternating sockets, then the siblings
+    CHECK_EQ(std::string("0 1 2 3 8 4 5 6 7"), order(sysfs, placement_scatter));
+    // the siblings of a core, then the cores of the socket
+    CHECK_EQ(std::string("0 4 2 6 8 1 5 3 7"), order(sysfs, placement_compact));
+    // no topology at all: every cpu is a core of socket 0
+    CHECK_EQ(std::string("0 1 2 3 4 5 6 7 8"),
+             order(tmp + "/none", placement_scatter));
+    CHECK_EQ(std::string("0 1 2 3 4 5 6 7 8"),
+             order(tmp + "/none", placement_compact));
+}
+
+int main(int argc, char *argv[]) {
+    char tmp[] = "/tmp/cpumap_unit.XXXXXX";
+    assert(mkdtemp(tmp));
+    test_parse_cpu_list();
+    test_quota(tmp);
+    test_placement(tmp);
+    assert(system((std::string("rm -rf ") + tmp).c_str()) == 0);
+    std::cout << "PASS" << std::endl;
+    return 0;
+}
@@ -0,0 +1,84 @@
+/* Metis
+ * Yandong Mao, Robert Morris, Frans Kaashoek
+ * Copyright (c) 2012 Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, subject to the conditions listed
+ * in the Metis LICENSE file. These conditions include: you must preserve this
+ * copyright notice, and you cannot mention the copyright holders in
+ * advertising related to the Software without their permission.  The Software
+ * is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Metis LICENSE file; the license in that file is legally
+ * binding.
+ */
+#include "hll.hh"
+#include "bench.hh"
+#include "test_util.hh"
+#include <iostream>
+
+static void check_near(double actual, double expected, double error) {
+    std::cout << "\t" << actual << " (expected " << expected << ")" << std::endl;
+    CHECK_GT(actual, expected * (1 - error));
+    CHECK_GT(expected * (1 + error), actual);
+}
+
+static void test_hyperloglog() {
+    hyperloglog h, h2;
+    h.init();
+    h2.init();
+    CHECK_EQ(0.0, h.estimate());
+    for (uint64_t i = 0; i < 100; ++i)
+        h.add(fmix64(i));
+    check_near(h.estimate(), 100, 0.05);
+    for (uint64_t i = 0; i < 100000; ++i) {
+        h.add(fmix64(i));
+        h.add(fmix64(i));  // duplicates are not counted
+    }
+    check_near(h.estimate(), 100000, 0.05);
+    for (uint64_t i = 100000; i < 200000; ++i)
+        h2.add(fmix64(i));
+    h.merge(h2);
+    check_near(h.estimate(), 200000, 0.05);
+}
+
+/* @brief: emit @npair pairs of each of @nsample sampled tasks,
+   with keys drawn uniformly from @nkey keys */
+static uint64_t predict(int nsample, int ntask, int npair, uint32_t nkey) {
+    distinct_estimator de[2];
+    de[0].init();
+    de[1].init();
+    // per-core set of seen keys, for newkey
+    bool *seen[2];
+    for (int c = 0; c < 2; ++c)
+        seen[c] = (bool *)calloc(nkey, sizeof(bool));
+    uint32_t seed = 1;
+    for (int i = 0; i < nsample; ++i) {
+        const int c = i % 2;
+        de[c].task_start(i, nsample);
+        for (int j = 0; j < npair; ++j) {
+            uint32_t k = rnd(&seed) % nkey;
+            de[c].onepair(!seen[c][k], k);
+            seen[c][k] = true;
+        }
+    }
+    for (int c = 0; c < 2; ++c)
+        free(seen[c]);
+    return distinct_estimator::predict(de, 2, ntask, nsample);
+}
+
+static void test_distinct_estimator() {
+    // the sample already covers all keys
+    check_near(predict(20, 400, 5000, 1000), 1000, 0.1);
+    // all keys are distinct, so the number of keys grows linearly
+    check_near(predict(20, 400, 1000, 1 << 30), 400 * 1000, 0.1);
+    // no pair was emitted
+    CHECK_EQ(uint64_t(0), predict(20, 400, 0, 1000));
+}
+
+int main(int argc, char *argv[]) {
+    test_hyperloglog();
+    test_distinct_estimator();
+    std::cout << "PASS" << std::endl;
+    return 0;
+}
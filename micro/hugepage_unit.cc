@@ -0,0 +1,112 @@
+/* Metis
+ * Yandong Mao, Robert Morris, Frans Kaashoek
+ * Copyright (c) 2012 Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, subject to the conditions listed
+ * in the Metis LICENSE file. These conditions include: you must preserve this
+ * copyright notice, and you cannot mention the copyright holders in
+ * advertising related to the Software without their permission.  The Software
+ * is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Metis LICENSE file; the license in that file is legally
+ * binding.
+ */
+#include "hugepage.hh"
+#include "test_util.hh"
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <iostream>
+
+// two and a half chunks
+enum { file_size = huge_page_size * 5 / 2 };
+
+static char byte_at(size_t i) {
+    return 'a' + i % 26;
+}
+
+static int make_file(char *path) {
+    const int fd = mkstemp(path);
+    assert(fd >= 0);
+    char *buf = (char *)malloc(file_size);
+    for (size_t i = 0; i < file_size; ++i)
+        buf[i] = byte_at(i);
+    assert(write(fd, buf, file_size) == file_size);
+    free(buf);
+    return fd;
+}
+
+static void check_bytes(huge_page_file &f, size_t first, size_t last) {
+    for (size_t i = first; i < last; ++i)
+        if (f.data()[i] != byte_at(i))
+            CHECK_EQ(byte_at(i), f.data()[i]);
+}
+
+static void test_read() {
+    char path[] = "/tmp/hugepage_unit.XXXXXX";
+    const int fd = make_file(path);
+    huge_page_file f(fd, file_size);
+    CHECK_EQ(size_t(3), huge_page_pending_chunks());
+    // the chunk of a byte looked at before the job is read at once
+    f.read_chunk_of(huge_page_size + 1);
+    CHECK_EQ(byte_at(huge_page_size + 1), f.data()[huge_page_size + 1]);
+    CHECK_EQ(0, f.data()[0]);
+    CHECK_EQ(false, huge_page_file_read(f.data()));
+    // the workers read the chunks in any order, in disjoint ranges
+    huge_page_read_pending(2, 3);
+    huge_page_read_pending(0, 2);
+    huge_page_pending_done();
+    CHECK_EQ(size_t(0), huge_page_pending_chunks());
+    CHECK_EQ(true, huge_page_file_read(f.data() + file_size - 1));
+    CHECK_EQ(false, huge_page_file_read(f.data() + file_size));
+    check_bytes(f, 0, file_size);
+    CHECK_EQ(0, f.data()[file_size]);
+    close(fd);
+    unlink(path);
+}
+
+static void test_shrunk_file() {
+    char path[] = "/tmp/hugepage_unit.XXXXXX";
+    const int fd = make_file(path);
+    huge_page_file f(fd, file_size);
+    // the file loses its last chunk and a half before the job
+    const size_t size = huge_page_size;
+    assert(ftruncate(fd, size) == 0);
+    huge_page_read_pending(0, huge_page_pending_chunks());
+    huge_page_pending_done();
+    check_bytes(f, 0, size);
+    for (size_t i = size; i <= file_size; ++i)
+        if (f.data()[i])
+            CHECK_EQ(0, f.data()[i]);
+    close(fd);
+    unlink(path);
+}
+
+static void test_files() {
+    char p1[] = "/tmp/hugepage_unit.XXXXXX", p2[] = "/tmp/hugepage_unit.XXXXXX";
+    const int fd1 = make_file(p1), fd2 = make_file(p2);
+    huge_page_file *f1 = new huge_page_file(fd1, file_size);
+    huge_page_file f2(fd2, huge_page_size / 2);
+    huge_page_file empty(fd2, 0);
+    // the chunks of all files are numbered together
+    CHECK_EQ(size_t(4), huge_page_pending_chunks());
+    delete f1;
+    CHECK_EQ(size_t(1), huge_page_pending_chunks());
+    huge_page_read_pending(0, 1);
+    huge_page_pending_done();
+    check_bytes(f2, 0, huge_page_size / 2);
+    close(fd1);
+    close(fd2);
+    unlink(p1);
+    unlink(p2);
+}
+
+int main(int argc, char *argv[]) {
+    test_read();
+    test_shrunk_file();
+    test_files();
+    std::cout << "PASS" << std::endl;
+    return 0;
+}
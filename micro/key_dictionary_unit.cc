@@ -0,0 +1,104 @@
+/* Metis
+ * Yandong Mao, Robert Morris, Frans Kaashoek
+ * Copyright (c) 2012 Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, subject to the conditions listed
+ * in the Metis LICENSE file. These conditions include: you must preserve this
+ * copyright notice, and you cannot mention the copyright holders in
+ * advertising related to the Software without their permission.  The Software
+ * is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Metis LICENSE file; the license in that file is legally
+ * binding.
+ */
+#include "key_dictionary.hh"
+#include "bench.hh"
+#include "test_util.hh"
+#include <pthread.h>
+#include <stdio.h>
+#include <iostream>
+
+enum { nthread = 4, nkey = 20000 };
+
+struct intern_arg {
+    key_dictionary *d_;
+    int me_;
+    uint32_t ids_[nkey];
+};
+
+static void key_of(int k, char *buf, size_t len) {
+    snprintf(buf, len, "key-%d", k);
+}
+
+static unsigned hash_of(const char *s) {
+    unsigned h = 5381;
+    for (; *s; ++s)
+        h = ((h << 5) + h) + unsigned(*s);
+    return h;
+}
+
+/* @brief: intern all keys, starting from a different key on each thread,
+   so that the threads race to insert the same keys */
+static void *intern_all(void *x) {
+    intern_arg *a = (intern_arg *) x;
+    char buf[32];
+    for (int i = 0; i < nkey; ++i) {
+        const int k = (i + a->me_ * nkey / nthread) % nkey;
+        key_of(k, buf, sizeof(buf));
+        a->ids_[k] = a->d_->intern(buf, strlen(buf), hash_of(buf), false);
+    }
+    return NULL;
+}
+
+static void test_concurrent_intern() {
+    key_dictionary *d = new key_dictionary;
+    intern_arg *args = new intern_arg[nthread];
+    pthread_t tid[nthread];
+    for (int i = 0; i < nthread; ++i) {
+        args[i].d_ = d;
+        args[i].me_ = i;
+        assert(pthread_create(&tid[i], NULL, intern_all, &args[i]) == 0);
+    }
+    for (int i = 0; i < nthread; ++i)
+        pthread_join(tid[i], NULL);
+    // every key got one id, the same on all threads, and the ids are dense
+    CHECK_EQ(uint32_t(nkey + 1), d->id_end());
+    bool *seen = (bool *) calloc(nkey + 1, sizeof(bool));
+    char buf[32];
+    for (int k = 0; k < nkey; ++k) {
+        const uint32_t id = args[0].ids_[k];
+        for (int i = 1; i < nthread; ++i)
+            CHECK_EQ(id, args[i].ids_[k]);
+        CHECK_GT(id, uint32_t(0));
+        CHECK_EQ(false, seen[id]);
+        seen[id] = true;
+        key_of(k, buf, sizeof(buf));
+        CHECK_EQ(std::string(buf), std::string(d->key(id)));
+        CHECK_EQ(strlen(buf), d->length(id));
+        // the key is not stable, so the dictionary keeps its own copy
+        CHECK_EQ((void *) d->key(id), d->source(id));
+    }
+    free(seen);
+    // the destructor skips the keys freed already
+    d->free_keys(0, nkey / 2);
+    delete d;
+    delete[] args;
+}
+
+static void test_stable_keys() {
+    key_dictionary d;
+    char k[] = "stable";
+    const uint32_t id = d.intern(k, strlen(k), hash_of(k), true);
+    CHECK_EQ((void *) k, d.source(id));
+    CHECK_EQ(id, d.intern(k, strlen(k), hash_of(k), true));
+    CHECK_EQ(id + 1, d.intern(k, 3, hash_of("sta"), true));
+    CHECK_EQ(std::string("sta"), std::string(d.key(id + 1)));
+}
+
+int main(int argc, char *argv[]) {
+    test_concurrent_intern();
+    test_stable_keys();
+    std::cout << "PASS" << std::endl;
+    return 0;
+}
@@ -20,6 +20,16 @@ int main(int argc, char *argv[]) {
     uint64_t f = get_cpu_freq();
     std::cout << f << std::endl;
     CHECK_GT(f, uint64_t(0));
+
+    // the calibrated clock must agree with the wall clock
+    uint64_t t0 = read_clock();
+    uint64_t u0 = usec();
+    usleep(100000);
+    uint64_t ms = clock_to_ms(read_clock() - t0);
+    uint64_t wall_ms = (usec() - u0) / 1000;
+    std::cout << ms << " " << wall_ms << std::endl;
+    CHECK_GT(ms + 5, wall_ms);
+    CHECK_GT(wall_ms + 5, ms);
     std::cout << "PASS" << std::endl;
     return 0;
 }
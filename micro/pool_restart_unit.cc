@@ -0,0 +1,90 @@
+/* Metis
+ * Yandong Mao, Robert Morris, Frans Kaashoek
+ * Copyright (c) 2012 Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, subject to the conditions listed
+ * in the Metis LICENSE file. These conditions include: you must preserve this
+ * copyright notice, and you cannot mention the copyright holders in
+ * advertising related to the Software without their permission.  The Software
+ * is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Metis LICENSE file; the license in that file is legally
+ * binding.
+ */
+#include "application.hh"
+#include "cpumap.hh"
+#include "memstat.hh"
+#include "test_util.hh"
+#include <iostream>
+
+enum { nkey = 16, nvalue = 1 << 16, nsplit = 64 };
+
+static int keys[nkey];
+static int values[nvalue];
+
+/* @brief: count the values of each key, nsplit values per map task */
+struct count : public map_reduce {
+    count() : next_(0) {}
+    bool split(split_t *ma, int ncore) {
+        if (next_ == nvalue)
+            return false;
+        ma->data = &values[next_];
+        ma->length = nsplit;
+        next_ += nsplit;
+        return true;
+    }
+    int key_compare(const void *k1, const void *k2) {
+        return *(const int *) k1 - *(const int *) k2;
+    }
+    void map_function(split_t *ma, emitter &e) {
+        const int *v = (const int *) ma->data;
+        for (size_t i = 0; i < ma->length; ++i)
+            e.map_emit(&keys[v[i]], int2ptr(1), sizeof(int));
+    }
+    void reduce_function(void *k, void **v, size_t length, emitter &e) {
+        intptr_t sum = 0;
+        for (size_t i = 0; i < length; ++i)
+            sum += ptr2int<intptr_t>(v[i]);
+        e.reduce_emit(k, int2ptr(sum));
+    }
+  private:
+    int next_;
+};
+
+/* @brief: run one job on @ncore cores in a fresh worker pool, and check
+   its results and that its allocations were counted */
+static void run_job(int ncore) {
+    mapreduce_appbase::initialize();
+    uint64_t nalloc0[mem_nsubsys], bytes0[mem_nsubsys];
+    mem_sum(nalloc0, bytes0);
+    count *app = new count;
+    app->set_ncore(ncore);
+    app->sched_run();
+    CHECK_EQ(size_t(nkey), app->results_.size());
+    for (int i = 0; i < nkey; ++i) {
+        CHECK_EQ(i, *(int *) app->results_[i].key_);
+        CHECK_EQ(intptr_t(nvalue / nkey),
+                 ptr2int<intptr_t>(app->results_[i].val));
+    }
+    uint64_t nalloc[mem_nsubsys], bytes[mem_nsubsys];
+    mem_sum(nalloc, bytes);
+    CHECK_GT(nalloc[mem_map_ds], nalloc0[mem_map_ds]);
+    app->free_results();
+    delete app;
+    mapreduce_appbase::deinitialize();
+}
+
+int main(int argc, char *argv[]) {
+    for (int i = 0; i < nkey; ++i)
+        keys[i] = i;
+    for (int i = 0; i < nvalue; ++i)
+        values[i] = i % nkey;
+    // the second pool is larger than the first, which sized the per-core
+    // arrays it used
+    run_job(1);
+    run_job(cpumap_ncpu());
+    run_job(1);
+    std::cout << "PASS" << std::endl;
+    return 0;
+}
@@ -0,0 +1,118 @@
+/* Metis
+ * Yandong Mao, Robert Morris, Frans Kaashoek
+ * Copyright (c) 2012 Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, subject to the conditions listed
+ * in the Metis LICENSE file. These conditions include: you must preserve this
+ * copyright notice, and you cannot mention the copyright holders in
+ * advertising related to the Software without their permission.  The Software
+ * is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Metis LICENSE file; the license in that file is legally
+ * binding.
+ */
+#include "psrs.hh"
+#include "mr-types.hh"
+#include "bench.hh"
+#include "test_util.hh"
+#include <pthread.h>
+#include <iostream>
+
+enum { ncpu = 4 };
+
+typedef xarray<keyval_t> pair_array;
+
+static int pair_compare(const void *a, const void *b) {
+    const intptr_t x = ptr2int<intptr_t>(((const keyval_t *) a)->key_);
+    const intptr_t y = ptr2int<intptr_t>(((const keyval_t *) b)->key_);
+    return x < y ? -1 : (x > y);
+}
+
+struct sort_arg {
+    psrs<pair_array> *p_;
+    xarray<pair_array> *in_;
+    int me_;
+    pair_array *share_;
+};
+
+static void *sort_share(void *x) {
+    sort_arg *a = (sort_arg *) x;
+    a->share_ = a->p_->do_psrs(*a->in_, ncpu, a->me_, pair_compare);
+    return NULL;
+}
+
+static intptr_t key(pair_array *a, size_t i) {
+    return ptr2int<intptr_t>(a->at(i)->key_);
+}
+
+/* @brief: sort @n pairs, spread over the input of all cores, with keys
+   drawn from [0, @nkey), and check that the shares of the cores are
+   sorted, hold all pairs, and never split a key */
+static void check_psrs(size_t n, int nkey, uint32_t seed) {
+    xarray<pair_array> in(ncpu);
+    in.zero();
+    xarray<int> count(nkey);
+    count.zero();
+    for (size_t i = 0; i < n; ++i) {
+        const int k = rnd(&seed) % nkey;
+        ++count[k];
+        // uneven inputs, as the map outputs of the cores are
+        in[(i * i) % ncpu].push_back(keyval_t(int2ptr(k)));
+    }
+    psrs<pair_array> p(ncpu);
+    pair_array *out = p.init(main_core, n);
+    sort_arg args[ncpu];
+    pthread_t tid[ncpu];
+    for (int i = 0; i < ncpu; ++i) {
+        args[i].p_ = &p;
+        args[i].in_ = &in;
+        args[i].me_ = i;
+        if (i != main_core)
+            assert(pthread_create(&tid[i], NULL, sort_share, &args[i]) == 0);
+    }
+    sort_share(&args[main_core]);
+    for (int i = 0; i < ncpu; ++i)
+        if (i != main_core)
+            pthread_join(tid[i], NULL);
+
+    CHECK_EQ(n, out->size());
+    for (size_t i = 1; i < n; ++i)
+        CHECK_EQ(true, key(out, i - 1) <= key(out, i));
+    size_t total = 0;
+    intptr_t last = -1;  // the last key of the previous shares
+    for (int c = 0; c < ncpu; ++c) {
+        pair_array *s = args[c].share_;
+        for (size_t i = 0; i < s->size(); ++i) {
+            if (i == 0)
+                CHECK_GT(key(s, i), last);
+            --count[key(s, i)];
+        }
+        if (s->size())
+            last = key(s, s->size() - 1);
+        total += s->size();
+        s->init();  // the shares point into out
+        delete s;
+    }
+    CHECK_EQ(n, total);
+    for (int k = 0; k < nkey; ++k)
+        CHECK_EQ(0, count[k]);
+    out->shallow_free();
+    delete out;
+    for (int i = 0; i < ncpu; ++i)
+        in[i].shallow_free();
+}
+
+int main(int argc, char *argv[]) {
+    // distinct keys
+    check_psrs(10000, 1 << 20, 1);
+    // few keys, so that most pivots are equal
+    check_psrs(10000, 3, 2);
+    check_psrs(5000, 7, 3);
+    // a single key
+    check_psrs(4000, 1, 4);
+    // too few pairs to split, sorted by the main core alone
+    check_psrs(20, 5, 5);
+    std::cout << "PASS" << std::endl;
+    return 0;
+}
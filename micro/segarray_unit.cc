@@ -0,0 +1,87 @@
+/* Metis
+ * Yandong Mao, Robert Morris, Frans Kaashoek
+ * Copyright (c) 2012 Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, subject to the conditions listed
+ * in the Metis LICENSE file. These conditions include: you must preserve this
+ * copyright notice, and you cannot mention the copyright holders in
+ * advertising related to the Software without their permission.  The Software
+ * is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Metis LICENSE file; the license in that file is legally
+ * binding.
+ */
+#include "segarray.hh"
+#include "bench.hh"
+#include "test_util.hh"
+#include <iostream>
+
+// small chunks, so that the tests cross many chunk boundaries
+typedef segarray<int, 3> int_segarray;
+
+static int compare(const void *a, const void *b) {
+    return *reinterpret_cast<const int *>(a) - *reinterpret_cast<const int *>(b);
+}
+
+static void fill(int_segarray &a, size_t n, uint32_t seed) {
+    a.init();
+    for (size_t i = 0; i < n; ++i)
+        a.push_back(rnd(&seed) % 1000);
+}
+
+static void test_append() {
+    int_segarray a;
+    for (int i = 0; i < 100; ++i)
+        a.push_back(i);
+    CHECK_EQ(size_t(100), a.size());
+    for (int i = 0; i < 100; ++i)
+        CHECK_EQ(i, a[i]);
+    int n = 0;
+    for (int_segarray::iterator it = a.begin(); it != a.end(); ++it, ++n)
+        CHECK_EQ(n, *it.current());
+    CHECK_EQ(100, n);
+    CHECK_EQ(100, a.end() - a.begin());
+    a.clear();
+    CHECK_EQ(size_t(0), a.size());
+    CHECK_EQ(true, a.begin() == a.end());
+}
+
+static void test_sort() {
+    // within the first chunk, and across chunks
+    const size_t sizes[] = {0, 1, 5, 8, 9, 1000};
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        int_segarray a;
+        fill(a, sizes[s], s + 1);
+        a.sort(compare);
+        CHECK_EQ(sizes[s], a.size());
+        for (size_t i = 1; i < a.size(); ++i)
+            CHECK_EQ(true, a[i - 1] <= a[i]);
+    }
+}
+
+static void test_transfer() {
+    const size_t sizes[] = {0, 6, 8, 20, 1001};
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        int_segarray a, b;
+        fill(a, sizes[s], s + 1);
+        fill(b, sizes[s], s + 1);
+        xarray<int> x;
+        CHECK_EQ(sizes[s], a.transfer(&x));
+        CHECK_EQ(size_t(0), a.size());
+        CHECK_EQ(sizes[s], x.size());
+        for (size_t i = 0; i < x.size(); ++i)
+            CHECK_EQ(b[i], x[i]);
+        // a can be reused
+        a.push_back(1);
+        CHECK_EQ(1, a[0]);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    test_append();
+    test_sort();
+    test_transfer();
+    std::cout << "PASS" << std::endl;
+    return 0;
+}
@@ -30,7 +30,7 @@ struct gstate_type {
 	    volatile uint64_t cycles;
 	} v;
 	char __pad[JOS_CLINE];
-    } state[JOS_NCPU] __attribute__ ((aligned(JOS_CLINE)));
+    } state[0] __attribute__ ((aligned(JOS_CLINE)));
 };
 
 static gstate_type *gstate;
@@ -82,11 +82,11 @@ main(int argc, char **argv)
 	exit(EXIT_FAILURE);
     }
     ncores = atoi(argv[1]);
-    assert(ncores <= JOS_NCPU);
+    const size_t gsize = sizeof(gstate_type) + ncores * sizeof(gstate->state[0]);
     gstate = (gstate_type *)
-	mmap(NULL, sizeof(gstate_type), PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS,
+	mmap(NULL, gsize, PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS,
 	     -1, 0);
-    memset(gstate, 0, sizeof(gstate_type));
+    memset(gstate, 0, gsize);
     if (gstate == MAP_FAILED) {
 	printf("mmap error: %d\n", errno);
 	exit(EXIT_FAILURE);
@@ -99,5 +99,5 @@ main(int argc, char **argv)
     worker(int2ptr(0));
     uint64_t end = read_tsc();
     printf("Total time %ld million cycles\n", (end - start) / 1000000);
-    munmap(gstate, sizeof(*gstate));
+    munmap(gstate, gsize);
 }
@@ -0,0 +1,122 @@
+/* Metis
+ * Yandong Mao, Robert Morris, Frans Kaashoek
+ * Copyright (c) 2012 Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, subject to the conditions listed
+ * in the Metis LICENSE file. These conditions include: you must preserve this
+ * copyright notice, and you cannot mention the copyright holders in
+ * advertising related to the Software without their permission.  The Software
+ * is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Metis LICENSE file; the license in that file is legally
+ * binding.
+ */
+#include "array.hh"
+#include "bench.hh"
+#include "test_util.hh"
+#include <iostream>
+
+typedef small_xarray<long, 2> small_array;
+
+static void check_values(small_array &a, size_t n, long first = 0) {
+    CHECK_EQ(n, a.size());
+    for (size_t i = 0; i < n; ++i)
+        CHECK_EQ(first + long(i), a[i]);
+}
+
+static void test_push_back() {
+    small_array a;
+    CHECK_EQ(size_t(0), a.size());
+    // inline, then on the heap, then grown on the heap
+    for (long i = 0; i < 100; ++i) {
+        a.push_back(i);
+        check_values(a, i + 1);
+    }
+    a.clear();
+    CHECK_EQ(size_t(0), a.size());
+    // reusable after clear
+    a.push_back(7);
+    CHECK_EQ(7L, a[0]);
+}
+
+static void test_append() {
+    long x[50];
+    for (long i = 0; i < 50; ++i)
+        x[i] = i;
+    // within the inline elements, across the boundary, and far beyond
+    const size_t sizes[] = {1, 2, 3, 50};
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        small_array a, b;
+        a.push_back(-1);
+        a.append(x, sizes[s]);
+        CHECK_EQ(sizes[s] + 1, a.size());
+        CHECK_EQ(-1L, a[0]);
+        for (size_t i = 0; i < sizes[s]; ++i)
+            CHECK_EQ(long(i), a[i + 1]);
+        b.append(a);
+        CHECK_EQ(a.size(), b.size());
+        for (size_t i = 0; i < a.size(); ++i)
+            CHECK_EQ(a[i], b[i]);
+    }
+}
+
+static void test_release() {
+    // from the inline elements and from the heap
+    for (size_t n = 0; n < 6; ++n) {
+        small_array a;
+        for (size_t i = 0; i < n; ++i)
+            a.push_back(i);
+        long *r = a.release();
+        CHECK_EQ(size_t(0), a.size());
+        CHECK_EQ(n == 0, r == NULL);
+        for (size_t i = 0; i < n; ++i)
+            CHECK_EQ(long(i), r[i]);
+        free(r);
+    }
+}
+
+static void test_move() {
+    // assign moves the elements, wherever they are
+    for (size_t n = 1; n < 5; ++n) {
+        small_array *a = new small_array;
+        for (size_t i = 0; i < n; ++i)
+            a->push_back(i + 10);
+        small_array b;
+        b.assign(*a);
+        a->init();  // a no longer owns the elements
+        delete a;
+        check_values(b, n, 10);
+        b.push_back(10 + n);
+        check_values(b, n + 1, 10);
+    }
+}
+
+static void test_multiplex() {
+    small_array a;
+    CHECK_EQ(0L, a.multiplex_value());
+    a.set_multiplex_value(42);
+    CHECK_EQ(true, a.multiplex());
+    CHECK_EQ(size_t(1), a.size());
+    CHECK_EQ(42L, a.multiplex_value());
+    a.set_multiplex_value(43);
+    CHECK_EQ(43L, a.multiplex_value());
+    a.init();
+    CHECK_EQ(false, a.multiplex());
+    a.push_back(1);
+    a.push_back(2);
+    a.push_back(3);
+    check_values(a, 3, 1);
+    a.trim(1);
+    check_values(a, 1, 1);
+}
+
+int main(int argc, char *argv[]) {
+    test_push_back();
+    test_append();
+    test_release();
+    test_move();
+    test_multiplex();
+    std::cout << "PASS" << std::endl;
+    return 0;
+}
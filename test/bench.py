@@ -0,0 +1,170 @@
+#!/usr/bin/env python
+#
+# Measures the scalability of the applications: runs each of them with a
+# sweep of core counts (-p) under several Metis strategies (-S), repeats
+# every run, and reports the per-phase times as CSV together with a
+# speedup/efficiency summary. It benchmarks the current build unless
+# --configs asks to reconfigure and rebuild the tree for each configuration.
+#
+#   $ ./test/bench.py --cores 1,2,4,8 --repeat 5 --csv bench.csv
+#   $ make bench BENCH_ARGS="--sanity"
+
+from __future__ import print_function
+import subprocess, sys, os, re, multiprocessing, optparse
+
+phases = ['Split', 'Sample', 'Map', 'Reduce', 'Merge', 'Sum', 'Real']
+
+# name, program, full args, sanity args. The full inputs are generated by
+# `make data_gen`; see test/run_all.py.
+apps = [
+    ('wrmem', 'wrmem', '', '-s 1'),
+    ('kmeans', 'kmeans', '10 16 5000000 40', '10 16 5000 40'),
+    ('pca', 'pca', '-R 2048 -C 2048', '-R 512 -C 100'),
+    ('matrix_mult', 'matrix_mult', '-l 2048', '-l 100'),
+    ('hist', 'hist', 'data/hist-2.6g.bmp', 'data/3MB.bmp'),
+    ('linear_regression', 'linear_regression', 'data/lr_4GB.txt', 'data/lr_10MB.txt'),
+    ('string_match', 'string_match', 'data/sm_1GB.txt', 'data/wc/10MB.txt'),
+    ('wc', 'wc', 'data/wc/300MB_1M_Keys.txt', 'data/wc/10MB.txt'),
+    ('wr', 'wr', 'data/wr/100MB_1M_Keys.txt', 'data/wc/10MB.txt'),
+    ('wr-800MB', 'wr', 'data/wr/800MB.txt', None),
+    ('minmaponly', 'minmaponly', 'data/wc/300MB_1M_Keys.txt', 'data/wc/10MB.txt'),
+]
+
+# execution strategies (see lib/strategy.hh), chosen at runtime
+strategies = [
+    '',
+    'map-ds=array',
+    'map-ds=append',
+    'sort=mergesort',
+    'mode=single_btree',
+]
+
+def default_cores():
+    n = multiprocessing.cpu_count()
+    cores = []
+    c = 1
+    while c < n:
+        cores.append(c)
+        c *= 2
+    cores.append(n)
+    return ','.join(str(x) for x in cores)
+
+def execute(cmd):
+    p = subprocess.Popen(cmd, shell = True, stdout = subprocess.PIPE,
+                         stderr = subprocess.STDOUT)
+    out = p.communicate()[0].decode('utf-8', 'replace')
+    return p.returncode, out
+
+def rebuild(configure):
+    print('[configure %s]' % configure, file = sys.stderr)
+    for cmd in ['./configure %s' % configure, 'make clean',
+                'make -j%d' % multiprocessing.cpu_count()]:
+        ret, out = execute(cmd)
+        if ret != 0:
+            sys.stderr.write(out)
+            sys.exit('%s failed' % cmd)
+
+def parse_times(out):
+    """Sums the phase times of every print_stats of a run, in milliseconds."""
+    times = dict((p, 0) for p in phases)
+    lines = out.splitlines()
+    found = False
+    for i, l in enumerate(lines):
+        if not l.startswith('Runtime in millisecond') or i + 1 >= len(lines):
+            continue
+        found = True
+        for k, v in re.findall(r'(\w+):\s+(\d+)', lines[i + 1]):
+            if k in times:
+                times[k] += int(v)
+    return times if found else None
+
+def input_of(args):
+    for a in args.split():
+        if a.startswith('data/'):
+            return a
+    return None
+
+def median(l):
+    l = sorted(l)
+    n = len(l)
+    return l[n // 2] if n % 2 else (l[n // 2 - 1] + l[n // 2]) / 2.0
+
+def main():
+    parser = optparse.OptionParser()
+    parser.add_option('--cores', default = default_cores(),
+                      help = 'comma separated core counts [%default]')
+    parser.add_option('--repeat', type = 'int', default = 3,
+                      help = 'runs per core count [%default]')
+    parser.add_option('--apps', default = '',
+                      help = 'comma separated applications [all]')
+    parser.add_option('--strategies', default = None,
+                      help = 'semicolon separated strategies passed with -S')
+    parser.add_option('--configs', default = None,
+                      help = 'semicolon separated ./configure arguments; '
+                             'runs ./configure, make clean and make in this '
+                             'tree for each [benchmark the current build]')
+    parser.add_option('--sanity', action = 'store_true', default = False,
+                      help = 'use the small sanity inputs')
+    parser.add_option('--csv', default = None,
+                      help = 'write the CSV to this file instead of stdout')
+    opts, args = parser.parse_args()
+
+    cores = [int(c) for c in opts.cores.split(',')]
+    selected = opts.apps.split(',') if opts.apps else None
+    if opts.configs is not None:
+        cfgs = opts.configs.split(';')
+    else:
+        cfgs = [None]
+    if opts.strategies is not None:
+        strats = opts.strategies.split(';')
+    else:
+        strats = strategies
+
+    csv = open(opts.csv, 'w') if opts.csv else sys.stdout
+    csv.write('config,app,ncore,run,%s\n' % ','.join(p.lower() for p in phases))
+    # (config, app) -> ncore -> list of real times
+    results = {}
+    for cfg in cfgs:
+        if cfg is not None:
+            rebuild(cfg)
+        for strat in strats:
+            cfgname = 'current' if cfg is None else (cfg or 'default')
+            if strat:
+                cfgname += ' ' + strat
+            for name, prog, full, sanity in apps:
+                if selected and name not in selected:
+                    continue
+                a = sanity if opts.sanity else full
+                if a is None or (input_of(a) and not os.path.exists(input_of(a))):
+                    print('skip %s: no input' % name, file = sys.stderr)
+                    continue
+                if strat:
+                    a += ' -S %s' % strat
+                for n in cores:
+                    for r in range(opts.repeat):
+                        cmd = './obj/%s %s -p %d -q' % (prog, a, n)
+                        print('[%s]' % cmd, file = sys.stderr)
+                        ret, out = execute(cmd)
+                        times = parse_times(out) if ret == 0 else None
+                        if times is None:
+                            print('\tFAIL', file = sys.stderr)
+                            continue
+                        csv.write('%s,%s,%d,%d,%s\n' % (cfgname, name, n, r,
+                                  ','.join(str(times[p]) for p in phases)))
+                        csv.flush()
+                        results.setdefault((cfgname, name), {}).setdefault(n, []).append(times['Real'])
+
+    print('\n%-28s %-18s %6s %10s %8s %10s' % ('config', 'app', 'ncore', 'real(ms)',
+                                               'speedup', 'efficiency'))
+    for cfgname, name in sorted(results.keys()):
+        r = results[(cfgname, name)]
+        base_n = min(r.keys())
+        base = median(r[base_n])
+        for n in sorted(r.keys()):
+            t = median(r[n])
+            speedup = float(base) / t if t else 0
+            print('%-28s %-18s %6d %10.1f %8.2f %10.2f' % (
+                  cfgname, name, n, t, speedup, speedup * base_n / n))
+
+if __name__ == '__main__':
+    main()
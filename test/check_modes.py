@@ -0,0 +1,82 @@
+#!/usr/bin/env python
+#
+# Checks that the applications print the same results under every mode,
+# with the dense keys on and off, as they do under the default strategy.
+# linear_regression and kmeans read result_segments_ (see
+# set_unordered_output), which each mode fills differently.
+#
+#   $ make sanity_data && ./test/check_modes.py
+#   $ make check_modes
+
+from __future__ import print_function
+import subprocess, sys, os
+
+# name, program, args, input that must exist
+apps = [
+    ('kmeans', 'kmeans', '10 16 5000 40', None),
+    ('linear_regression', 'linear_regression', 'data/lr_10MB.txt',
+     'data/lr_10MB.txt'),
+]
+
+modes = ['metis', 'single_btree', 'single_append-group_first',
+         'single_append-merge_first']
+
+# print_stats prints these headers, each but Strategy followed by one line
+# of numbers, which differ from run to run
+stats = ['Runtime in millisecond', 'Number of Tasks', 'Memory allocated',
+         'Peak RSS']
+
+def results(out):
+    """Drops the statistics from the output of a run."""
+    kept = []
+    lines = out.splitlines()
+    i = 0
+    while i < len(lines):
+        l = lines[i]
+        i += 1
+        if l.startswith('Strategy:'):
+            continue
+        if any(l.startswith(s) for s in stats):
+            i += 1
+            continue
+        kept.append(l)
+    return kept
+
+def run(prog, args, strategy):
+    cmd = './obj/%s %s -S %s' % (prog, args, strategy)
+    p = subprocess.Popen(cmd, shell = True, stdout = subprocess.PIPE,
+                         stderr = subprocess.STDOUT)
+    out = p.communicate()[0].decode('utf-8', 'replace')
+    if p.returncode != 0:
+        sys.stderr.write(out)
+        return cmd, None
+    return cmd, results(out)
+
+def main():
+    passed = failed = skipped = 0
+    for name, prog, args, path in apps:
+        if path and not os.path.exists(path):
+            print('skip %s: %s is missing (see make sanity_data)' % (name, path))
+            skipped += 1
+            continue
+        cmd, expect = run(prog, args, 'mode=metis')
+        if expect is None:
+            print('[%s]\n\tFAIL' % cmd)
+            failed += 1
+            continue
+        for mode in modes:
+            for dense in ['on', 'off']:
+                cmd, got = run(prog, args,
+                               'mode=%s,dense-keys=%s' % (mode, dense))
+                print('[%s]' % cmd)
+                if got == expect:
+                    print('\tPASS')
+                    passed += 1
+                else:
+                    print('\tFAIL')
+                    failed += 1
+    print('%d failed, %d passed, %d skipped' % (failed, passed, skipped))
+    return 1 if failed else 0
+
+if __name__ == '__main__':
+    sys.exit(main())